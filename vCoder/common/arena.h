@@ -0,0 +1,212 @@
+//
+//  arena.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace vcoder::common
+{
+    /// @brief A bump allocator: memory is carved out of large blocks and only ever freed all at once.
+    /// @remarks Nothing allocated here gets destroyed: objects living in an arena must not own memory outside of it.
+    ///          Releasing costs O(blocks), however many allocations were made.
+    class Arena
+    {
+    public:
+        /// @brief Constructs an empty arena: no memory is reserved until the first allocation.
+        /// @param blockSize The size of the blocks to allocate from the heap
+        explicit Arena(std::size_t blockSize = 64 * 1024)
+        : mHead(nullptr), mCursor(nullptr), mEnd(nullptr), mBlockSize(blockSize), mBlockCount(0), mUsed(0) {}
+        
+        Arena(const Arena&) = delete;
+        
+        ~Arena()
+        {
+            release();
+        }
+        
+        /// @brief Allocates memory from the arena.
+        /// @param size The number of bytes
+        /// @param align The alignment: must be a power of 2 no larger than alignof(std::max_align_t)
+        /// @return The memory: valid until the arena is released
+        void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+        {
+            auto start = alignUp(mCursor, align);
+            if(!mCursor || start + size > mEnd)
+            {
+                // Large allocations get a block of their own so they don't waste the rest of the current one
+                if(size > mBlockSize / 4)
+                    return addBlock(size, false);
+                
+                addBlock(mBlockSize, true);
+                start = alignUp(mCursor, align);
+            }
+            
+            mCursor = start + size;
+            mUsed += size;
+            return start;
+        }
+        
+        /// @brief Frees every block at once.
+        void release()
+        {
+            while(mHead)
+            {
+                auto next = mHead->next;
+                ::operator delete(mHead);
+                mHead = next;
+            }
+            
+            mCursor = mEnd = nullptr;
+            mBlockCount = 0;
+            mUsed = 0;
+        }
+        
+        /// @brief Gets the number of blocks allocated from the heap.
+        /// @return The block count
+        std::size_t blockCount() const
+        {
+            return mBlockCount;
+        }
+        
+        /// @brief Gets the number of bytes handed out since the last release, padding excluded.
+        /// @return The byte count
+        std::size_t bytesUsed() const
+        {
+            return mUsed;
+        }
+        
+        /// @brief Gets the arena the current thread allocates from, as set by ArenaScope.
+        /// @return The arena or nullptr to use the heap
+        static Arena* current()
+        {
+            return currentRef();
+        }
+    
+    private:
+        friend class ArenaScope;
+        
+        struct alignas(std::max_align_t) Block
+        {
+            Block* next;
+        };
+        
+        static Arena*& currentRef()
+        {
+            static thread_local Arena* arena = nullptr;
+            return arena;
+        }
+        
+        static char* alignUp(char* ptr, std::size_t align)
+        {
+            auto value = reinterpret_cast<std::uintptr_t>(ptr);
+            return reinterpret_cast<char*>((value + align - 1) & ~(std::uintptr_t(align) - 1));
+        }
+        
+        void* addBlock(std::size_t size, bool current)
+        {
+            auto block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+            block->next = mHead;
+            mHead = block;
+            mBlockCount++;
+            
+            auto data = reinterpret_cast<char*>(block + 1);
+            if(current)
+            {
+                mCursor = data;
+                mEnd = data + size;
+            }
+            else
+                mUsed += size;
+            return data;
+        }
+        
+        Block* mHead;
+        char* mCursor;
+        char* mEnd;
+        std::size_t mBlockSize;
+        std::size_t mBlockCount;
+        std::size_t mUsed;
+    };
+    
+    /// @brief A standard allocator over an arena, falling back to the heap when there's none.
+    /// @remarks Lets containers of arena-allocated objects keep their storage in the arena as well.
+    template<class T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+        
+        ArenaAllocator(Arena* arena = nullptr) noexcept
+        : mArena(arena) {}
+        
+        template<class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : mArena(other.arena()) {}
+        
+        T* allocate(std::size_t count)
+        {
+            auto bytes = count * sizeof(T);
+            return static_cast<T*>(mArena ? mArena->allocate(bytes, alignof(T)) : ::operator new(bytes));
+        }
+        
+        void deallocate(T* ptr, std::size_t) noexcept
+        {
+            // Arena memory is only freed along with the arena
+            if(!mArena)
+                ::operator delete(ptr);
+        }
+        
+        /// @brief Gets the arena this allocator draws from.
+        /// @return The arena or nullptr for the heap
+        Arena* arena() const noexcept
+        {
+            return mArena;
+        }
+        
+        template<class U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept
+        {
+            return mArena == other.arena();
+        }
+        
+        template<class U>
+        bool operator!=(const ArenaAllocator<U>& other) const noexcept
+        {
+            return mArena != other.arena();
+        }
+    
+    private:
+        Arena* mArena;
+    };
+    
+    /// @brief Makes an arena current for the calling thread while in scope: classes that support it allocate from it.
+    class ArenaScope
+    {
+    public:
+        /// @brief Makes the arena current.
+        /// @param arena The arena: nullptr to go back to the heap
+        explicit ArenaScope(Arena* arena)
+        : mPrevious(Arena::currentRef())
+        {
+            Arena::currentRef() = arena;
+        }
+        
+        ArenaScope(const ArenaScope&) = delete;
+        
+        /// @brief Restores the arena that was current before.
+        ~ArenaScope()
+        {
+            Arena::currentRef() = mPrevious;
+        }
+    
+    private:
+        Arena* mPrevious;
+    };
+}
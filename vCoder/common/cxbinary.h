@@ -0,0 +1,508 @@
+//
+//  cxbinary.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "reflection.h"
+
+/*
+ --- CX binary encoding ---
+ A compact, positional encoding driven by the same CXPROPS metadata as SerializeObject.
+ Layout: [8-byte schema hash][properties in declaration order]
+ - bool: 1 byte
+ - integers/enums: LEB128 varints (signed ones zigzag-encoded)
+ - floating point: raw IEEE 754 bytes
+ - strings: varint length + bytes
+ - sequences, sets and maps: varint count + elements; vectors and arrays of arithmetic types are copied in bulk
+ - std::array: elements only, the size is part of the schema
+ - Optional/Reference/std::optional: 1 presence byte + value
+ - custom types: whatever their SerializeTo(Writer&)/DeserializeFrom(Reader&) hooks emit
+ Raw bytes are stored in host order: all of our targets are little-endian.
+ Usage example:
+ std::string data = CX::SerializeBinary(obj);
+ auto copy = CX::DeserializeBinary<ReflectedClass>(data);
+ */
+
+namespace CX
+{
+    namespace Binary
+    {
+        class DecodeException : public std::exception
+        {
+        public:
+            const char* what() const noexcept override { return "CX::Binary: truncated or malformed data"; }
+        };
+        
+        class SchemaMismatchException : public std::exception
+        {
+        public:
+            const char* what() const noexcept override { return "CX::Binary: data was written with a different schema"; }
+        };
+        
+        // Appends encoded values to an internal byte buffer
+        class Writer
+        {
+        public:
+            void WriteByte(std::uint8_t byte) { mBuffer.push_back(static_cast<char>(byte)); }
+            
+            void WriteVarint(std::uint64_t value)
+            {
+                while (value >= 0x80)
+                {
+                    WriteByte(static_cast<std::uint8_t>(value | 0x80));
+                    value >>= 7;
+                }
+                WriteByte(static_cast<std::uint8_t>(value));
+            }
+            
+            void WriteSigned(std::int64_t value)
+            {
+                WriteVarint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+            }
+            
+            void WriteBytes(const void* data, std::size_t size)
+            {
+                mBuffer.append(static_cast<const char*>(data), size);
+            }
+            
+            void WriteString(const std::string& str)
+            {
+                WriteVarint(str.size());
+                WriteBytes(str.data(), str.size());
+            }
+            
+            void Reserve(std::size_t size) { mBuffer.reserve(size); }
+            
+            const std::string& Buffer() const { return mBuffer; }
+            std::string Take() { return std::move(mBuffer); }
+        private:
+            std::string mBuffer;
+        };
+        
+        // Reads encoded values from a byte range: throws DecodeException when running out of data
+        class Reader
+        {
+        public:
+            Reader(const void* data, std::size_t size)
+            : mCursor(static_cast<const std::uint8_t*>(data)), mEnd(mCursor + size) {}
+            
+            std::uint8_t ReadByte()
+            {
+                if (mCursor == mEnd)
+                    throw DecodeException();
+                return *mCursor++;
+            }
+            
+            std::uint64_t ReadVarint()
+            {
+                std::uint64_t value = 0;
+                for (unsigned shift = 0; shift < 64; shift += 7)
+                {
+                    auto byte = ReadByte();
+                    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                    if (!(byte & 0x80))
+                        return value;
+                }
+                throw DecodeException();
+            }
+            
+            std::int64_t ReadSigned()
+            {
+                auto value = ReadVarint();
+                return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+            }
+            
+            void ReadBytes(void* data, std::size_t size)
+            {
+                if (Remaining() < size)
+                    throw DecodeException();
+                if (size)
+                    std::memcpy(data, mCursor, size);
+                mCursor += size;
+            }
+            
+            std::string ReadString()
+            {
+                auto size = ReadLength(1);
+                std::string str(reinterpret_cast<const char*>(mCursor), size);
+                mCursor += size;
+                return str;
+            }
+            
+            // Reads an element count and checks it against the remaining data so corrupt input can't force huge allocations
+            std::size_t ReadLength(std::size_t minElementSize)
+            {
+                auto count = ReadVarint();
+                if (minElementSize && count > Remaining() / minElementSize)
+                    throw DecodeException();
+                return static_cast<std::size_t>(count);
+            }
+            
+            std::size_t Remaining() const { return static_cast<std::size_t>(mEnd - mCursor); }
+            bool AtEnd() const { return mCursor == mEnd; }
+        private:
+            const std::uint8_t* mCursor;
+            const std::uint8_t* mEnd;
+        };
+        
+        // String transport for custom types that only implement Serialize()/Deserialize() - found through ADL
+        inline void WriteCustomString(Writer& out, std::string&& str) { out.WriteString(str); }
+        inline std::string ReadCustomString(Reader& in) { return in.ReadString(); }
+        
+        namespace Internal
+        {
+            template<class V>
+            constexpr bool IsBulkCopyable = std::is_arithmetic<V>::value && !std::is_same<V, bool>::value;
+            
+            inline void HashBytes(std::uint64_t& hash, const char* str)
+            {
+                for (; *str; ++str)
+                {
+                    hash ^= static_cast<unsigned char>(*str);
+                    hash *= 1099511628211ull;
+                }
+                hash ^= 0xFF; // separator
+                hash *= 1099511628211ull;
+            }
+            
+            template<class T>
+            std::uint64_t SchemaHash();
+            
+            // Mixes the shape of a value type into the schema hash
+            template<class V>
+            void HashType(std::uint64_t& hash)
+            {
+                using namespace CX::Reflection::Internal;
+                
+                if constexpr (IsCXCustom<V>::value)
+                    HashBytes(hash, "custom");
+                else if constexpr (IsCXReference<V>::value)
+                    HashBytes(hash, "ref"); // may be self-referential: don't recurse
+                else if constexpr (IsCXOptional<V>::value)
+                {
+                    HashBytes(hash, "opt");
+                    HashType<typename V::ValueType>(hash);
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                {
+                    hash ^= SchemaHash<V>();
+                    hash *= 1099511628211ull;
+                }
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    HashBytes(hash, "opt");
+                    HashType<typename V::value_type>(hash);
+                }
+                else if constexpr (IsStdMap<V>::value)
+                {
+                    HashBytes(hash, "map");
+                    HashType<typename V::key_type>(hash);
+                    HashType<typename V::mapped_type>(hash);
+                }
+                else if constexpr (IsStdArray<V>::value)
+                {
+                    HashBytes(hash, "arr");
+                    hash ^= std::tuple_size<V>::value;
+                    hash *= 1099511628211ull;
+                    HashType<typename V::value_type>(hash);
+                }
+                else if constexpr (IsStdSequence<V>::value || IsStdSet<V>::value)
+                {
+                    HashBytes(hash, "vec"); // all of these share the same layout
+                    HashType<typename V::value_type>(hash);
+                }
+                else if constexpr (std::is_same<V, std::string>::value || std::is_same<V, std::string_view>::value)
+                    HashBytes(hash, "str");
+                else if constexpr (std::is_same<V, bool>::value)
+                    HashBytes(hash, "bool");
+                else if constexpr (std::is_floating_point<V>::value)
+                    HashBytes(hash, sizeof(V) == 4 ? "f32" : "f64");
+                else if constexpr (std::is_integral<V>::value || std::is_enum<V>::value)
+                    HashBytes(hash, std::is_signed<V>::value ? "int" : "uint");
+                else
+                    static_assert(sizeof(V) == 0, "CX::Binary: unsupported property type");
+            }
+            
+            // Hash of the property names and types of T: written as a header to detect incompatible data
+            template<class T>
+            std::uint64_t SchemaHash()
+            {
+                static const std::uint64_t hash = [] {
+                    std::uint64_t h = 14695981039346656037ull;
+                    constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                    CX::Reflection::Internal::ForIntSequence(std::make_index_sequence<nbProperties>{}, [&](auto i) {
+                        constexpr auto property = std::get<i>(T::CXXREFLECT_INTERNAL_PLISTNAME());
+                        HashBytes(h, property.name);
+                        HashType<typename decltype(property)::Type>(h);
+                    });
+                    return h;
+                }();
+                return hash;
+            }
+            
+            template<class T>
+            void EncodeObject(Writer& out, const T& obj);
+            template<class T>
+            void DecodeObject(Reader& in, T& obj);
+            
+            template<class V>
+            void EncodeValue(Writer& out, const V& value)
+            {
+                using namespace CX::Reflection::Internal;
+                
+                if constexpr (IsCXCustom<V>::value)
+                    value.SerializeTo(out);
+                else if constexpr (IsCXReference<V>::value)
+                {
+                    out.WriteByte(value.Exists());
+                    if (value.Exists())
+                        EncodeValue<typename V::ValueType>(out, value);
+                }
+                else if constexpr (IsCXOptional<V>::value)
+                {
+                    out.WriteByte(value.Exists());
+                    if (value.Exists())
+                        EncodeValue(out, value());
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                    EncodeObject(out, value);
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    out.WriteByte(value.has_value());
+                    if (value)
+                        EncodeValue(out, *value);
+                }
+                else if constexpr (IsStdMap<V>::value)
+                {
+                    out.WriteVarint(value.size());
+                    for (auto& pair : value)
+                    {
+                        EncodeValue<typename V::key_type>(out, pair.first);
+                        EncodeValue<typename V::mapped_type>(out, pair.second);
+                    }
+                }
+                else if constexpr (IsStdArray<V>::value || IsStdVector<V>::value)
+                {
+                    using vectype = typename V::value_type;
+                    
+                    if constexpr (IsStdVector<V>::value)
+                        out.WriteVarint(value.size());
+                    
+                    if constexpr (IsBulkCopyable<vectype>)
+                        out.WriteBytes(value.data(), value.size() * sizeof(vectype));
+                    else
+                        for (const auto& val : value)
+                            EncodeValue<vectype>(out, val);
+                }
+                else if constexpr (IsStdSequence<V>::value || IsStdSet<V>::value)
+                {
+                    out.WriteVarint(value.size());
+                    for (auto& val : value)
+                        EncodeValue<typename V::value_type>(out, val);
+                }
+                else if constexpr (std::is_same<V, std::string>::value)
+                    out.WriteString(value);
+                else if constexpr (std::is_same<V, std::string_view>::value)
+                {
+                    out.WriteVarint(value.size());
+                    out.WriteBytes(value.data(), value.size());
+                }
+                else if constexpr (std::is_same<V, bool>::value)
+                    out.WriteByte(value ? 1 : 0);
+                else if constexpr (std::is_floating_point<V>::value)
+                    out.WriteBytes(&value, sizeof(V));
+                else if constexpr (std::is_enum<V>::value)
+                    EncodeValue(out, static_cast<std::underlying_type_t<V>>(value));
+                else if constexpr (std::is_integral<V>::value && std::is_signed<V>::value)
+                    out.WriteSigned(value);
+                else
+                    out.WriteVarint(value);
+            }
+            
+            template<class V>
+            void DecodeValue(Reader& in, V& value)
+            {
+                using namespace CX::Reflection::Internal;
+                
+                if constexpr (IsCXCustom<V>::value)
+                    value.DeserializeFrom(in);
+                else if constexpr (IsCXReference<V>::value)
+                {
+                    if (in.ReadByte())
+                    {
+                        typename V::ValueType val;
+                        DecodeValue(in, val);
+                        value.Set(val);
+                    }
+                }
+                else if constexpr (IsCXOptional<V>::value)
+                {
+                    if (in.ReadByte())
+                    {
+                        typename V::ValueType val;
+                        DecodeValue(in, val);
+                        value.Set(val);
+                    }
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                    DecodeObject(in, value);
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    if (in.ReadByte())
+                        DecodeValue(in, value.emplace());
+                    else
+                        value.reset();
+                }
+                else if constexpr (IsStdMap<V>::value)
+                {
+                    using keytype = typename V::key_type;
+                    using maptype = typename V::mapped_type;
+                    static_assert(!std::is_same<keytype, std::string_view>::value, "CX::Binary: string_view keys can't own decoded data");
+                    
+                    auto count = in.ReadLength(1);
+                    value.clear();
+                    if constexpr (HasReserve<V>::value)
+                        value.reserve(count);
+                    
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        keytype key;
+                        DecodeValue(in, key);
+                        DecodeValue(in, value.emplace_hint(value.end(), std::move(key), maptype())->second);
+                    }
+                }
+                else if constexpr (IsStdArray<V>::value || IsStdVector<V>::value)
+                {
+                    using vectype = typename V::value_type;
+                    
+                    if constexpr (IsStdVector<V>::value)
+                    {
+                        value.clear();
+                        value.resize(in.ReadLength(IsBulkCopyable<vectype> ? sizeof(vectype) : 1));
+                    }
+                    
+                    if constexpr (IsBulkCopyable<vectype>)
+                        in.ReadBytes(value.data(), value.size() * sizeof(vectype));
+                    else if constexpr (std::is_same<vectype, bool>::value)
+                        for (std::size_t i = 0; i < value.size(); i++)
+                            value[i] = in.ReadByte() != 0; // std::vector<bool> has no addressable elements
+                    else
+                        for (auto& val : value)
+                            DecodeValue(in, val);
+                }
+                else if constexpr (IsStdSequence<V>::value)
+                {
+                    auto count = in.ReadLength(1);
+                    value.clear();
+                    for (std::size_t i = 0; i < count; i++)
+                        DecodeValue(in, value.emplace_back());
+                }
+                else if constexpr (IsStdSet<V>::value)
+                {
+                    using keytype = typename V::key_type;
+                    
+                    auto count = in.ReadLength(1);
+                    value.clear();
+                    if constexpr (HasReserve<V>::value)
+                        value.reserve(count);
+                    
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        keytype key;
+                        DecodeValue(in, key);
+                        value.emplace_hint(value.end(), std::move(key));
+                    }
+                }
+                else if constexpr (std::is_same<V, std::string>::value)
+                    value = in.ReadString();
+                else if constexpr (std::is_same<V, std::string_view>::value)
+                    static_assert(sizeof(V) == 0, "CX::Binary: string_view values can't own decoded data, use std::string");
+                else if constexpr (std::is_same<V, bool>::value)
+                    value = in.ReadByte() != 0;
+                else if constexpr (std::is_floating_point<V>::value)
+                    in.ReadBytes(&value, sizeof(V));
+                else if constexpr (std::is_enum<V>::value)
+                {
+                    std::underlying_type_t<V> val;
+                    DecodeValue(in, val);
+                    value = static_cast<V>(val);
+                }
+                else if constexpr (std::is_integral<V>::value && std::is_signed<V>::value)
+                    value = static_cast<V>(in.ReadSigned());
+                else
+                    value = static_cast<V>(in.ReadVarint());
+            }
+            
+            // Not using CXENUM here: the encoding is positional, so there's no need to materialize property names
+            template<class T>
+            void EncodeObject(Writer& out, const T& obj)
+            {
+                constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                CX::Reflection::Internal::ForIntSequence(std::make_index_sequence<nbProperties>{}, [&](auto i) {
+                    constexpr auto property = std::get<i>(T::CXXREFLECT_INTERNAL_PLISTNAME());
+                    EncodeValue<typename decltype(property)::Type>(out, obj.*(property.member));
+                });
+            }
+            
+            template<class T>
+            void DecodeObject(Reader& in, T& obj)
+            {
+                constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                CX::Reflection::Internal::ForIntSequence(std::make_index_sequence<nbProperties>{}, [&](auto i) {
+                    constexpr auto property = std::get<i>(T::CXXREFLECT_INTERNAL_PLISTNAME());
+                    DecodeValue<typename decltype(property)::Type>(in, obj.*(property.member));
+                });
+            }
+        }
+    }
+    
+    template<class T>
+    void SerializeBinary(const T& obj, Binary::Writer& out)
+    {
+        auto hash = Binary::Internal::SchemaHash<T>();
+        out.WriteBytes(&hash, sizeof(hash));
+        Binary::Internal::EncodeObject(out, obj);
+    }
+    
+    template<class T>
+    std::string SerializeBinary(const T& obj)
+    {
+        Binary::Writer out;
+        SerializeBinary(obj, out);
+        return out.Take();
+    }
+    
+    template<class T>
+    void DeserializeBinary(Binary::Reader& in, T& obj)
+    {
+        std::uint64_t hash;
+        in.ReadBytes(&hash, sizeof(hash));
+        if (hash != Binary::Internal::SchemaHash<T>())
+            throw Binary::SchemaMismatchException();
+        Binary::Internal::DecodeObject(in, obj);
+    }
+    
+    template<class T>
+    void DeserializeBinary(const std::string& data, T& obj)
+    {
+        Binary::Reader in(data.data(), data.size());
+        DeserializeBinary(in, obj);
+    }
+    
+    template<class T>
+    T DeserializeBinary(const std::string& data)
+    {
+        T obj;
+        DeserializeBinary(data, obj);
+        return obj;
+    }
+}
@@ -0,0 +1,244 @@
+//
+//  cxcompare.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "reflection.h"
+
+/*
+ --- CX hashing, equality and diffing ---
+ Generated from the CXPROPS property list: no text round-trip involved.
+ - Hash: combines the hashes of all properties; unordered containers hash independently of iteration order
+ - Equal: compares property by property and stops at the first difference
+ - Diff: lists the paths of all differing properties, descending into nested reflected objects ("inner.name")
+ Custom types are opaque to CX: they are hashed and compared through their Hash()/Equals() hooks, which
+ default to their Serialize() output.
+ Usage example:
+ if (!CX::Equal(a, b))
+     for (auto& path : CX::Diff(a, b))
+         std::cout << path << " changed" << std::endl;
+ */
+
+namespace CX
+{
+    namespace Compare
+    {
+        namespace Internal
+        {
+            template <class T, typename = std::void_t<>>
+            struct IsUnordered : std::false_type {
+            };
+            template <class T>
+            struct IsUnordered<T, std::void_t<typename T::hasher>> : std::true_type {};
+            
+            inline std::size_t Combine(std::size_t seed, std::size_t hash)
+            {
+                return seed ^ (hash + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+            }
+            
+            template<class T>
+            std::size_t HashObject(const T& obj);
+            template<class T>
+            bool EqualObjects(const T& a, const T& b);
+            
+            template<class V>
+            std::size_t HashValue(const V& value)
+            {
+                using namespace CX::Reflection::Internal;
+                
+                if constexpr (IsCXCustom<V>::value)
+                    return value.Hash();
+                else if constexpr (IsCXReference<V>::value || IsCXOptional<V>::value)
+                {
+                    using vtype = typename V::ValueType;
+                    return value.Exists() ? Combine(1, HashValue<vtype>(static_cast<const vtype&>(value))) : 0;
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                    return HashObject(value);
+                else if constexpr (IsStdOptional<V>::value)
+                    return value ? Combine(1, HashValue<typename V::value_type>(*value)) : 0;
+                else if constexpr (IsStdMap<V>::value || IsStdSet<V>::value || IsStdSequence<V>::value || IsStdArray<V>::value)
+                {
+                    std::size_t hash = value.size();
+                    for (const auto& val : value)
+                    {
+                        std::size_t h;
+                        if constexpr (IsStdMap<V>::value)
+                            h = Combine(HashValue<typename V::key_type>(val.first), HashValue<typename V::mapped_type>(val.second));
+                        else
+                            h = HashValue<typename V::value_type>(val);
+                        
+                        // Iteration order of unordered containers is arbitrary: mix their elements commutatively
+                        if constexpr (IsUnordered<V>::value)
+                            hash += Combine(0, h);
+                        else
+                            hash = Combine(hash, h);
+                    }
+                    return hash;
+                }
+                else if constexpr (std::is_floating_point<V>::value)
+                    return value == 0 ? 0 : std::hash<V>()(value); // +0.0 == -0.0
+                else if constexpr (std::is_same<V, std::string>::value)
+                    return std::hash<std::string_view>()(value);
+                else
+                    return std::hash<V>()(value);
+            }
+            
+            template<class V>
+            bool EqualValues(const V& a, const V& b)
+            {
+                using namespace CX::Reflection::Internal;
+                
+                if constexpr (IsCXCustom<V>::value)
+                    return a.Equals(b);
+                else if constexpr (IsCXReference<V>::value || IsCXOptional<V>::value)
+                {
+                    using vtype = typename V::ValueType;
+                    
+                    if (a.Exists() != b.Exists())
+                        return false;
+                    return !a.Exists() || EqualValues<vtype>(static_cast<const vtype&>(a), static_cast<const vtype&>(b));
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                    return EqualObjects(a, b);
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    if (a.has_value() != b.has_value())
+                        return false;
+                    return !a || EqualValues<typename V::value_type>(*a, *b);
+                }
+                else if constexpr (IsStdMap<V>::value || IsStdSet<V>::value || IsStdSequence<V>::value || IsStdArray<V>::value)
+                {
+                    if (a.size() != b.size())
+                        return false;
+                    
+                    if constexpr (IsUnordered<V>::value)
+                    {
+                        for (const auto& val : a)
+                        {
+                            if constexpr (IsStdMap<V>::value)
+                            {
+                                auto it = b.find(val.first);
+                                if (it == b.end() || !EqualValues<typename V::mapped_type>(val.second, it->second))
+                                    return false;
+                            }
+                            else if (b.find(val) == b.end())
+                                return false;
+                        }
+                    }
+                    else
+                    {
+                        auto it = b.begin();
+                        for (const auto& val : a)
+                        {
+                            const auto& other = *it++;
+                            if constexpr (IsStdMap<V>::value)
+                            {
+                                if (!EqualValues<typename V::key_type>(val.first, other.first) ||
+                                    !EqualValues<typename V::mapped_type>(val.second, other.second))
+                                    return false;
+                            }
+                            else if (!EqualValues<typename V::value_type>(val, other))
+                                return false;
+                        }
+                    }
+                    return true;
+                }
+                else
+                    return a == b;
+            }
+            
+            template<class T, std::size_t... I>
+            std::size_t HashProperties(const T& obj, std::index_sequence<I...>)
+            {
+                constexpr auto properties = T::CXXREFLECT_INTERNAL_PLISTNAME();
+                std::size_t hash = sizeof...(I);
+                ((hash = Combine(hash, HashValue<typename std::tuple_element_t<I, decltype(properties)>::Type>(obj.*(std::get<I>(properties).member)))), ...);
+                return hash;
+            }
+            
+            // The && fold stops at the first differing property
+            template<class T, std::size_t... I>
+            bool EqualProperties(const T& a, const T& b, std::index_sequence<I...>)
+            {
+                constexpr auto properties = T::CXXREFLECT_INTERNAL_PLISTNAME();
+                return (EqualValues<typename std::tuple_element_t<I, decltype(properties)>::Type>(a.*(std::get<I>(properties).member),
+                                                                                                    b.*(std::get<I>(properties).member)) && ...);
+            }
+            
+            template<class T>
+            std::size_t HashObject(const T& obj)
+            {
+                constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                return HashProperties(obj, std::make_index_sequence<nbProperties>{});
+            }
+            
+            template<class T>
+            bool EqualObjects(const T& a, const T& b)
+            {
+                constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                return EqualProperties(a, b, std::make_index_sequence<nbProperties>{});
+            }
+            
+            template<class T>
+            void DiffObjects(const T& a, const T& b, const std::string& prefix, std::vector<std::string>& out)
+            {
+                constexpr auto nbProperties = std::tuple_size<decltype(T::CXXREFLECT_INTERNAL_PLISTNAME())>::value;
+                CX::Reflection::Internal::ForIntSequence(std::make_index_sequence<nbProperties>{}, [&](auto i) {
+                    constexpr auto property = std::get<i>(T::CXXREFLECT_INTERNAL_PLISTNAME());
+                    using type = typename decltype(property)::Type;
+                    
+                    if constexpr (CX::Reflection::Internal::IsCXReflectable<type>::value)
+                        DiffObjects(a.*(property.member), b.*(property.member), prefix + property.name + ".", out);
+                    else if (!EqualValues<type>(a.*(property.member), b.*(property.member)))
+                        out.push_back(prefix + property.name);
+                });
+            }
+        }
+    }
+    
+    // Hashes a reflected object from its properties
+    template<class T>
+    std::size_t Hash(const T& obj)
+    {
+        return Compare::Internal::HashObject(obj);
+    }
+    
+    // Compares two reflected objects property by property, stopping at the first difference
+    template<class T>
+    bool Equal(const T& a, const T& b)
+    {
+        return Compare::Internal::EqualObjects(a, b);
+    }
+    
+    // Lists the paths of the properties that differ between two reflected objects
+    template<class T>
+    std::vector<std::string> Diff(const T& a, const T& b)
+    {
+        std::vector<std::string> out;
+        Compare::Internal::DiffObjects(a, b, "", out);
+        return out;
+    }
+    
+    // Hasher/equality functors for unordered containers of reflected objects, e.g. to deduplicate them
+    template<class T>
+    struct Hasher
+    {
+        std::size_t operator()(const T& obj) const { return Hash(obj); }
+    };
+    
+    template<class T>
+    struct EqualTo
+    {
+        bool operator()(const T& a, const T& b) const { return Equal(a, b); }
+    };
+}
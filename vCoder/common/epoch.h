@@ -0,0 +1,147 @@
+//
+//  epoch.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace vcoder::common
+{
+    /// @brief Epoch-based reclamation: lets lock-free readers use objects a writer has already replaced, deferring
+    ///        their deletion until no reader can still see them.
+    /// @remarks Readers pin the current epoch in one of a fixed set of slots before loading a shared pointer and clear
+    ///          it when done: pinning is a single compare-and-swap. The writer retires replaced objects with the epoch
+    ///          they were replaced in, and deletes them once every pinned epoch is newer. retire() and reclaim() must
+    ///          only be called by one thread at a time; enter() and exit() may be called from any thread.
+    class EpochDomain
+    {
+    public:
+        static constexpr std::size_t kSlots = 64;
+        
+        /// @brief Pins the current epoch while in scope.
+        class Guard
+        {
+        public:
+            explicit Guard(EpochDomain& domain)
+            : mDomain(&domain), mSlot(domain.enter()) {}
+            
+            Guard(Guard&& other)
+            : mDomain(other.mDomain), mSlot(other.mSlot)
+            {
+                other.mDomain = nullptr;
+            }
+            
+            ~Guard()
+            {
+                if(mDomain)
+                    mDomain->exit(mSlot);
+            }
+        
+        private:
+            EpochDomain* mDomain;
+            std::size_t mSlot;
+        };
+        
+        EpochDomain()
+        : mEpoch(1)
+        {
+            for(auto& slot : mSlots)
+                slot.epoch.store(kIdle, std::memory_order_relaxed);
+        }
+        
+        EpochDomain(const EpochDomain&) = delete;
+        
+        /// @brief Deletes every retired object: no reader may be pinned anymore.
+        ~EpochDomain()
+        {
+            for(auto& retired : mRetired)
+                retired.deleter(retired.ptr);
+        }
+        
+        /// @brief Pins the current epoch for the calling reader.
+        /// @return The slot to pass to exit(): waits for one if all kSlots are taken
+        std::size_t enter()
+        {
+            for(;;)
+            {
+                for(std::size_t i = 0; i < kSlots; i++)
+                {
+                    // A stale epoch is harmless: it only keeps more objects alive
+                    auto expected = kIdle;
+                    if(mSlots[i].epoch.compare_exchange_strong(expected, mEpoch.load()))
+                        return i;
+                }
+                std::this_thread::yield();
+            }
+        }
+        
+        /// @brief Unpins a reader.
+        /// @param slot The slot enter() returned
+        void exit(std::size_t slot)
+        {
+            mSlots[slot].epoch.store(kIdle, std::memory_order_release);
+        }
+        
+        /// @brief Schedules an object for deletion once no reader can see it: it must already be unreachable for new
+        ///        readers.
+        /// @param ptr The object, allocated with new
+        template<class T>
+        void retire(const T* ptr)
+        {
+            mRetired.push_back({ const_cast<T*>(ptr), [](void* p) { delete static_cast<T*>(p); }, mEpoch.fetch_add(1) });
+            reclaim();
+        }
+        
+        /// @brief Deletes the retired objects no pinned reader can see anymore.
+        void reclaim()
+        {
+            auto oldest = kIdle;
+            for(auto& slot : mSlots)
+                oldest = std::min(oldest, slot.epoch.load());
+            
+            auto kept = mRetired.begin();
+            for(auto& retired : mRetired)
+            {
+                // Readers pinned after the object was retired can't have loaded it
+                if(retired.epoch < oldest)
+                    retired.deleter(retired.ptr);
+                else
+                    *kept++ = retired;
+            }
+            mRetired.erase(kept, mRetired.end());
+        }
+        
+        /// @brief Gets the number of retired objects still waiting for readers.
+        /// @return The object count
+        std::size_t pending() const
+        {
+            return mRetired.size();
+        }
+    
+    private:
+        static constexpr std::uint64_t kIdle = UINT64_MAX;
+        
+        struct alignas(64) Slot
+        {
+            std::atomic<std::uint64_t> epoch;
+        };
+        
+        struct Retired
+        {
+            void* ptr;
+            void (*deleter)(void*);
+            std::uint64_t epoch;
+        };
+        
+        std::atomic<std::uint64_t> mEpoch;
+        Slot mSlots[kSlots];
+        std::vector<Retired> mRetired;
+    };
+}
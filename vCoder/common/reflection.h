@@ -1,7 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <exception>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <tuple>
 
@@ -125,6 +136,14 @@ namespace CX
                 return PropertyImpl<Class, T>{member, name};
             }
             
+            // Whether no property of a reflected class needs its destructor run, e.g. to live in an arena
+            template<class T>
+            constexpr bool HasTriviallyDestructibleProperties() {
+                return std::apply([](auto... properties) {
+                    return (std::is_trivially_destructible<typename decltype(properties)::Type>::value && ...);
+                }, T::CXXREFLECT_INTERNAL_PLISTNAME());
+            }
+            
             template <class T, typename = std::void_t<>>
             struct IsCXReflectable : std::false_type {
             };
@@ -154,8 +173,60 @@ namespace CX
             };
             template<typename T, typename A>
             struct IsStdVector<std::vector<T, A>> : std::true_type {};
+            
+            // Sequences filled through emplace_back: vector, deque, list
+            template <class T, typename = std::void_t<>>
+            struct IsStdSequence : IsStdVector<T> {
+            };
+            template<typename T, typename A>
+            struct IsStdSequence<std::deque<T, A>> : std::true_type {};
+            template<typename T, typename A>
+            struct IsStdSequence<std::list<T, A>> : std::true_type {};
+            
+            template <class T, typename = std::void_t<>>
+            struct IsStdArray : std::false_type {
+            };
+            template<typename T, std::size_t N>
+            struct IsStdArray<std::array<T, N>> : std::true_type {};
+            
+            template <class T, typename = std::void_t<>>
+            struct IsStdOptional : std::false_type {
+            };
+            template<typename T>
+            struct IsStdOptional<std::optional<T>> : std::true_type {};
+            
+            // Associative containers: maps have a mapped_type, sets only a key_type
+            template <class T, typename = std::void_t<>>
+            struct IsStdMap : std::false_type {
+            };
+            template <class T>
+            struct IsStdMap<T, std::void_t<typename T::key_type, typename T::mapped_type>> : std::true_type {};
+            
+            template <class T, typename = std::void_t<>>
+            struct IsStdSet : std::false_type {
+            };
+            template <class T>
+            struct IsStdSet<T, std::void_t<typename T::key_type>> : std::negation<IsStdMap<T>> {};
+            
+            template <class T>
+            struct IsStringKey : std::disjunction<std::is_same<T, std::string>, std::is_same<T, std::string_view>> {};
+            
+            template <class T, typename = std::void_t<>>
+            struct HasReserve : std::false_type {
+            };
+            template <class T>
+            struct HasReserve<T, std::void_t<decltype(std::declval<T&>().reserve(std::size_t()))>> : std::true_type {};
         }
         
+        // Opt-in parallel deserialization of large vectors of reflected objects: the output vector is pre-sized
+        // and the source array is split into contiguous ranges, one per worker thread.
+        // Set these before deserializing: they are read without synchronization.
+        struct ParallelDeserialization
+        {
+            static inline std::size_t Threshold = 0; // Minimum vector size to go parallel: 0 disables the parallel path
+            static inline unsigned MaxThreads = 0; // 0 to use std::thread::hardware_concurrency()
+        };
+        
         class NullReferenceException : public std::exception
         {
         public:
@@ -211,141 +282,331 @@ namespace CX
             T mValue;
         };
         
+        namespace Internal
+        {
+            // Default string transport for custom types: formats that cannot be assigned from/converted to
+            // a std::string should provide their own overloads next to the format type (found through ADL)
+            template<class Format>
+            void WriteCustomString(Format& out, std::string&& str)
+            {
+                out = std::move(str);
+            }
+            
+            template<class Format>
+            std::string ReadCustomString(const Format& in)
+            {
+                return in.template get<std::string>();
+            }
+        }
+        
+        // Custom serialization for types CX can't reflect.
+        // Serialize/Deserialize go through a std::string: simple, but every field costs an extra allocation and
+        // a re-parse. Derived classes may hide SerializeTo/DeserializeFrom with their own templates to write to and
+        // read from the active format directly (JSON DOM, SAX stream, binary...) - CX always goes through those.
         template<typename Type>
         class CustomSerializable
         {
         public:
             bool CXCustom = true; // cust marker
             
+            virtual ~CustomSerializable() {}
+            
             virtual void Deserialize(const std::string& str) = 0;
             virtual std::string Serialize() const = 0;
             
+            // Format-aware hooks: the defaults fall back to the string round-trip above
+            template<class Format>
+            void SerializeTo(Format& out) const { using Internal::WriteCustomString; WriteCustomString(out, Serialize()); }
+            template<class Format>
+            void DeserializeFrom(Format& in) { using Internal::ReadCustomString; Deserialize(ReadCustomString(in)); }
+            
+            // Hashing and equality for CX::Hash/CX::Equal: the defaults compare the Serialize() strings, derived classes
+            // may hide them with ones working on the value directly (Equals then takes the derived type)
+            std::size_t Hash() const { return std::hash<std::string>()(Serialize()); }
+            bool Equals(const CustomSerializable& other) const { return Serialize() == other.Serialize(); }
+            
             Type& operator()() { return mValue; }
+            const Type& operator()() const { return mValue; }
         protected:
             Type mValue;
         };
     }
     
     template<class Format, class T>
-    Format SerializeObject(const T& obj)
+    Format SerializeObject(const T& obj);
+    
+    template<class T, class Format>
+    static void DeserializeObject(const Format& j, T& obj);
+    
+    namespace Reflection
     {
-        Format j;
-        CXENUM_CONST(T, obj) {
-            if constexpr (Reflection::Internal::IsCXCustom<type>::value)
+        namespace Internal
+        {
+            template<class Format, class V>
+            void DeserializeValue(const Format& j, V& value);
+            
+            // Set on worker threads so that nested vectors don't spawn threads of their own
+            inline thread_local bool gInParallelWorker = false;
+            
+            inline unsigned ParallelWorkerCount(std::size_t size)
             {
-                j[name] = SerializeObject<Format>(value);
+                auto threshold = ParallelDeserialization::Threshold;
+                if (!threshold || size < threshold || gInParallelWorker)
+                    return 1;
+                
+                unsigned threads = ParallelDeserialization::MaxThreads;
+                if (!threads)
+                    threads = std::max(1u, std::thread::hardware_concurrency());
+                
+                // Don't hand out ranges smaller than the threshold itself
+                return static_cast<unsigned>(std::min<std::size_t>(threads, size / threshold));
             }
-            else
+            
+            template<class Format, class V>
+            void DeserializeVectorParallel(const Format& j, V& value, unsigned workers)
             {
-                if constexpr (Reflection::Internal::IsStdVector<type>::value)
-                {
-                    using vectype = typename type::value_type;
-                    
-                    if constexpr (Reflection::Internal::IsCXReflectable<vectype>::value)
+                value.clear();
+                value.resize(j.size());
+                
+                std::exception_ptr error;
+                std::mutex errorMutex;
+                
+                auto convert = [&](std::size_t begin, std::size_t end) {
+                    gInParallelWorker = true;
+                    try {
+                        for (auto i = begin; i < end; i++)
+                            DeserializeValue(j[i], value[i]);
+                    }
+                    catch (...)
                     {
-                        for (auto& val : value)
-                            j[name].push_back(SerializeObject<Format>(val));
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
                     }
-                    else
+                    gInParallelWorker = false;
+                };
+                
+                auto chunk = (value.size() + workers - 1) / workers;
+                std::vector<std::thread> threads;
+                threads.reserve(workers - 1);
+                
+                for (unsigned i = 1; i < workers; i++)
+                    threads.emplace_back(convert, std::min(value.size(), i * chunk), std::min(value.size(), (i + 1) * chunk));
+                convert(0, std::min(value.size(), chunk));
+                
+                for (auto& thread : threads)
+                    thread.join();
+                
+                if (error)
+                    std::rethrow_exception(error);
+            }
+            
+            // Serializes a single value of any supported kind: reflected objects, CX wrappers, standard containers
+            // (nested arbitrarily) and anything the format itself can be assigned from
+            template<class Format, class V>
+            Format SerializeValue(const V& value)
+            {
+                if constexpr (IsCXCustom<V>::value)
+                {
+                    Format f;
+                    value.SerializeTo(f);
+                    return f;
+                }
+                else if constexpr (IsCXReference<V>::value || IsCXOptional<V>::value)
+                {
+                    using vtype = typename V::ValueType;
+                    
+                    if (!value.Exists())
+                        return Format();
+                    return SerializeValue<Format, vtype>(static_cast<const vtype&>(value));
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                {
+                    return SerializeObject<Format>(value);
+                }
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    if (!value)
+                        return Format();
+                    return SerializeValue<Format, typename V::value_type>(*value);
+                }
+                else if constexpr (IsStdMap<V>::value)
+                {
+                    using keytype = typename V::key_type;
+                    using maptype = typename V::mapped_type;
+                    
+                    Format f;
+                    for (auto& pair : value)
                     {
-                        for (auto& val : value)
-                            j[name].push_back((vectype)val);
+                        // String keys map onto format objects, anything else becomes a list of [key, value] pairs
+                        if constexpr (IsStringKey<keytype>::value)
+                            f[std::string(pair.first)] = SerializeValue<Format, maptype>(pair.second);
+                        else
+                        {
+                            Format kv;
+                            kv.push_back(SerializeValue<Format, keytype>(pair.first));
+                            kv.push_back(SerializeValue<Format, maptype>(pair.second));
+                            f.push_back(kv);
+                        }
                     }
+                    return f;
+                }
+                else if constexpr (IsStdSequence<V>::value || IsStdArray<V>::value || IsStdSet<V>::value)
+                {
+                    using vectype = typename V::value_type;
+                    
+                    Format f;
+                    for (const auto& val : value)
+                        f.push_back(SerializeValue<Format, vectype>(val));
+                    return f;
+                }
+                else if constexpr (std::is_same<V, std::string_view>::value)
+                {
+                    return Format(std::string(value));
                 }
                 else
                 {
-                    if constexpr (Reflection::Internal::IsCXReflectable<type>::value)
-                        j[name] = SerializeObject<Format>(value);
-                    else
-                        j[name] = value;
+                    Format f = value;
+                    return f;
                 }
             }
-        } CXENUM_END;
-        return j;
-    }
-        
-    template<class T, class Format>
-    static T DeserializeObject(const Format& j)
-    {
-        T obj;
-        DeserializeObject<T, Format>(j, obj);
-        return obj;
-    }
-    
-    template<class T, class Format>
-    static void DeserializeObject(const Format& j, T& obj)
-    {
-        CXENUM(T, obj)
-        {
-            try {
-                
-                if constexpr (Reflection::Internal::IsCXCustom<type>::value)
+            
+            // Deserializes a single value of any supported kind: containers are pre-sized from the source
+            template<class Format, class V>
+            void DeserializeValue(const Format& j, V& value)
+            {
+                if constexpr (IsCXCustom<V>::value)
                 {
-                    DeserializeObject<Format>(j.at(name));
+                    value.DeserializeFrom(j);
                 }
-                else if constexpr (Reflection::Internal::IsCXReference<type>::value)
+                else if constexpr (IsCXReference<V>::value || IsCXOptional<V>::value)
                 {
-                    j.at(name);
-                    value.Create();
-                    using vtype = typename type::ValueType;
+                    if (j.is_null())
+                        return;
                     
-                    if constexpr (Reflection::Internal::IsCXReflectable<vtype>::value)
-                        value.Set(DeserializeObject<vtype>(j.at(name)));
+                    typename V::ValueType val;
+                    DeserializeValue(j, val);
+                    value.Set(val);
+                }
+                else if constexpr (IsCXReflectable<V>::value)
+                {
+                    DeserializeObject<V>(j, value);
+                }
+                else if constexpr (IsStdOptional<V>::value)
+                {
+                    if (j.is_null())
+                        value.reset();
                     else
-                        value = j.at(name).template get<vtype>();
+                        DeserializeValue(j, value.emplace());
                 }
-                else if constexpr (Reflection::Internal::IsCXOptional<type>::value)
+                else if constexpr (IsStdMap<V>::value)
                 {
-                    using vtype = typename type::ValueType;
+                    using keytype = typename V::key_type;
+                    using maptype = typename V::mapped_type;
+                    static_assert(!std::is_same<keytype, std::string_view>::value,
+                                  "CX: string_view keys can't own deserialized data: use std::string keys with a transparent comparator/hash");
+                    
+                    value.clear();
+                    if constexpr (HasReserve<V>::value)
+                        value.reserve(j.size());
                     
-                    if constexpr (Reflection::Internal::IsStdVector<vtype>::value)
+                    if constexpr (IsStringKey<keytype>::value)
                     {
-                        using vectype = typename vtype::value_type;
-                        
-                        if constexpr (Reflection::Internal::IsCXReflectable<vectype>::value)
-                        {
-                            for (auto& val : j.at(name))
-                                value().push_back(DeserializeObject<vectype>(val));
-                        }
-                        else
+                        for (auto& item : j.items())
+                            DeserializeValue(item.value(), value.emplace_hint(value.end(), item.key(), maptype())->second);
+                    }
+                    else
+                    {
+                        for (auto& kv : j)
                         {
-                            for (auto& val : j.at(name))
-                                value().push_back(val.template get<vectype>());
+                            keytype key;
+                            DeserializeValue(kv.at(0), key);
+                            DeserializeValue(kv.at(1), value.emplace_hint(value.end(), std::move(key), maptype())->second);
                         }
                     }
-                    else
+                }
+                else if constexpr (IsStdSet<V>::value)
+                {
+                    using keytype = typename V::key_type;
+                    
+                    value.clear();
+                    if constexpr (HasReserve<V>::value)
+                        value.reserve(j.size());
+                    
+                    for (auto& val : j)
                     {
-                        if constexpr (Reflection::Internal::IsCXReflectable<vtype>::value)
-                            value = DeserializeObject<vtype>(j.at(name));
-                        else
-                            value = j.at(name).template get<vtype>();
+                        keytype key;
+                        DeserializeValue(val, key);
+                        value.emplace_hint(value.end(), std::move(key));
                     }
                 }
-                else
+                else if constexpr (IsStdArray<V>::value)
                 {
-                    if constexpr (Reflection::Internal::IsStdVector<type>::value)
+                    std::size_t i = 0;
+                    for (auto& val : j)
                     {
-                        using vectype = typename type::value_type;
-                        
-                        if constexpr (Reflection::Internal::IsCXReflectable<vectype>::value)
-                        {
-                            for (auto& val : j.at(name))
-                                value.push_back(DeserializeObject<vectype>(val));
-                        }
-                        else
-                        {
-                            for (auto& val : j.at(name))
-                                value.push_back(val.template get<vectype>());
-                        }
+                        if (i == value.size())
+                            break;
+                        DeserializeValue(val, value[i++]);
                     }
-                    else
+                }
+                else if constexpr (IsStdSequence<V>::value)
+                {
+                    using vectype = typename V::value_type;
+                    
+                    if constexpr (IsStdVector<V>::value && IsCXReflectable<vectype>::value)
+                    {
+                        auto workers = ParallelWorkerCount(j.size());
+                        if (workers > 1)
+                            return DeserializeVectorParallel(j, value, workers);
+                    }
+                    
+                    value.clear();
+                    if constexpr (HasReserve<V>::value)
+                        value.reserve(j.size());
+                    
+                    for (auto& val : j)
                     {
-                        if constexpr (Reflection::Internal::IsCXReflectable<type>::value)
-                            value = DeserializeObject<type>(j.at(name));
+                        if constexpr (std::is_same<vectype, bool>::value)
+                            value.push_back(val.template get<bool>()); // std::vector<bool> has no addressable elements
                         else
-                            value = j.at(name).template get<type>();
+                            DeserializeValue(val, value.emplace_back());
                     }
                 }
+                else
+                {
+                    static_assert(!std::is_same<V, std::string_view>::value, "CX: string_view properties can't own deserialized data");
+                    value = j.template get<V>();
+                }
+            }
+        }
+    }
+    
+    template<class Format, class T>
+    Format SerializeObject(const T& obj)
+    {
+        Format j;
+        CXENUM_CONST(T, obj) {
+            j[name] = Reflection::Internal::SerializeValue<Format, type>(value);
+        } CXENUM_END;
+        return j;
+    }
+    
+    template<class T, class Format>
+    static T DeserializeObject(const Format& j)
+    {
+        T obj;
+        DeserializeObject<T, Format>(j, obj);
+        return obj;
+    }
+    
+    template<class T, class Format>
+    static void DeserializeObject(const Format& j, T& obj)
+    {
+        CXENUM(T, obj)
+        {
+            try {
+                Reflection::Internal::DeserializeValue<Format, type>(j.at(name), value);
             }
             catch (...)
             {
@@ -0,0 +1,183 @@
+//
+//  symbolmap.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "arena.h"
+#include "symboltable.h"
+
+namespace vcoder::common
+{
+    /// @brief A flat hash multimap keyed by 32-bit ids, such as symbols or name hashes: one contiguous array with linear probing.
+    /// @remarks Lookups touch one or two cache lines on average as the table is kept at most half full. Erasing shifts
+    ///          the following entries back instead of leaving tombstones, so the table never degrades.
+    ///          The slots may live in an arena, in which case the map must not outlive it.
+    /// @tparam T The value type: must be trivially copyable and comparable with ==
+    template<class T>
+    class SymbolMultiMap
+    {
+    public:
+        /// @brief Constructs an empty map.
+        /// @param arena The arena to allocate slots from: nullptr to use the heap
+        explicit SymbolMultiMap(Arena* arena = nullptr)
+        : mSlots(nullptr), mCapacity(0), mSize(0), mArena(arena) {}
+        
+        SymbolMultiMap(const SymbolMultiMap&) = delete;
+        
+        ~SymbolMultiMap()
+        {
+            freeSlots();
+        }
+        
+        /// @brief Adds an entry: several entries may share a key.
+        /// @param key The key
+        /// @param value The value
+        void insert(Symbol key, const T& value)
+        {
+            if(2 * (mSize + 1) > mCapacity)
+                grow();
+            
+            auto i = home(key);
+            while(mSlots[i].used)
+                i = (i + 1) & mask();
+            
+            mSlots[i] = { key, value, true };
+            mSize++;
+        }
+        
+        /// @brief Removes one entry.
+        /// @param key The entry's key
+        /// @param value The entry's value
+        /// @return Whether the entry was found
+        bool erase(Symbol key, const T& value)
+        {
+            if(!mCapacity)
+                return false;
+            
+            auto i = home(key);
+            for(; mSlots[i].used; i = (i + 1) & mask())
+                if(mSlots[i].key == key && mSlots[i].value == value)
+                    break;
+            
+            if(!mSlots[i].used)
+                return false;
+            
+            // Backward shift: move later entries of the probe chain into the hole when it's on their way home
+            for(auto j = (i + 1) & mask(); mSlots[j].used; j = (j + 1) & mask())
+            {
+                auto k = home(mSlots[j].key);
+                auto between = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+                if(!between)
+                {
+                    mSlots[i] = mSlots[j];
+                    i = j;
+                }
+            }
+            
+            mSlots[i].used = false;
+            mSize--;
+            return true;
+        }
+        
+        /// @brief Finds an entry by key.
+        /// @param key The key
+        /// @return One of the values stored under the key or nullptr if there are none
+        const T* find(Symbol key) const
+        {
+            if(!mCapacity)
+                return nullptr;
+            
+            for(auto i = home(key); mSlots[i].used; i = (i + 1) & mask())
+                if(mSlots[i].key == key)
+                    return &mSlots[i].value;
+            return nullptr;
+        }
+        
+        /// @brief Invokes the callback for every value stored under a key, in no particular order.
+        /// @param key The key
+        /// @param fn The callback: must accept one argument of type const T&
+        template<class F>
+        void forEach(Symbol key, const F& fn) const
+        {
+            if(!mCapacity)
+                return;
+            
+            for(auto i = home(key); mSlots[i].used; i = (i + 1) & mask())
+                if(mSlots[i].key == key)
+                    fn(mSlots[i].value);
+        }
+        
+        /// @brief Gets the number of entries.
+        /// @return The number of entries
+        std::size_t size() const
+        {
+            return mSize;
+        }
+        
+        /// @brief Removes every entry.
+        void clear()
+        {
+            freeSlots();
+            mSlots = nullptr;
+            mCapacity = 0;
+            mSize = 0;
+        }
+    
+    private:
+        struct Slot
+        {
+            Symbol key;
+            T value;
+            bool used;
+        };
+        
+        std::size_t mask() const
+        {
+            return mCapacity - 1;
+        }
+        
+        /// @brief Gets the preferred slot of a key: Fibonacci hashing spreads consecutive symbols apart.
+        std::size_t home(Symbol key) const
+        {
+            return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask();
+        }
+        
+        void grow()
+        {
+            auto old = mSlots;
+            auto oldCapacity = mCapacity;
+            
+            mCapacity = oldCapacity ? 2 * oldCapacity : 16;
+            auto bytes = mCapacity * sizeof(Slot);
+            mSlots = static_cast<Slot*>(mArena ? mArena->allocate(bytes, alignof(Slot)) : ::operator new(bytes));
+            std::fill(mSlots, mSlots + mCapacity, Slot{ 0, T(), false });
+            mSize = 0;
+            
+            for(std::size_t i = 0; i < oldCapacity; i++)
+                if(old[i].used)
+                    insert(old[i].key, old[i].value);
+            
+            // Arena slots are abandoned: they're freed along with the arena
+            if(old && !mArena)
+                ::operator delete(old);
+        }
+        
+        void freeSlots()
+        {
+            if(mSlots && !mArena)
+                ::operator delete(mSlots);
+        }
+        
+        Slot* mSlots;
+        std::size_t mCapacity; // Always a power of 2
+        std::size_t mSize;
+        Arena* mArena;
+    };
+}
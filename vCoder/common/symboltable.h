@@ -0,0 +1,79 @@
+//
+//  symboltable.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace vcoder::common
+{
+    /// @brief An interned string: equal strings interned in the same table get equal symbols.
+    using Symbol = std::uint32_t;
+    
+    /// @brief Interns strings so that they can be stored, hashed and compared as small integers.
+    /// @remarks Symbols are dense (0, 1, 2...) and never freed, so they can index plain arrays. Interned strings
+    ///          keep their address for the table's lifetime. The table isn't synchronized: lookups may run
+    ///          concurrently with each other, but not with intern(), which can rehash the map and grow the storage.
+    class SymbolTable
+    {
+    public:
+        SymbolTable() = default;
+        SymbolTable(const SymbolTable&) = delete;
+        
+        /// @brief Interns a string, adding it to the table if needed.
+        /// @param str The string to intern
+        /// @return The string's symbol
+        Symbol intern(std::string_view str)
+        {
+            auto it = mSymbols.find(str);
+            if(it != mSymbols.end())
+                return it->second;
+            
+            // Keyed by a view of the stored copy: deque elements don't move
+            auto symbol = static_cast<Symbol>(mStrings.size());
+            auto& stored = mStrings.emplace_back(str);
+            mSymbols.emplace(stored, symbol);
+            return symbol;
+        }
+        
+        /// @brief Looks up a string without interning it.
+        /// @param str The string to look up
+        /// @param symbol Receives the string's symbol if it's found
+        /// @return Whether the string has been interned
+        bool find(std::string_view str, Symbol& symbol) const
+        {
+            auto it = mSymbols.find(str);
+            if(it == mSymbols.end())
+                return false;
+            
+            symbol = it->second;
+            return true;
+        }
+        
+        /// @brief Gets the string of a symbol.
+        /// @param symbol The symbol: must come from this table
+        /// @return The interned string
+        const std::string& str(Symbol symbol) const
+        {
+            return mStrings[symbol];
+        }
+        
+        /// @brief Gets the number of interned strings.
+        /// @return The number of strings: every symbol is below it
+        std::size_t size() const
+        {
+            return mStrings.size();
+        }
+    
+    private:
+        std::deque<std::string> mStrings;
+        std::unordered_map<std::string_view, Symbol> mSymbols;
+    };
+}
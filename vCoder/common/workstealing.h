@@ -0,0 +1,176 @@
+//
+//  workstealing.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vcoder::common
+{
+    /// @brief A fork-join work-stealing scheduler for recursively splittable work.
+    /// @remarks Each worker pushes and pops tasks at the back of its own deque, so it keeps working depth-first
+    ///          on its most recent (smallest) tasks; idle workers steal from the front of other deques, taking the
+    ///          oldest (largest) ones. Unbalanced work therefore gets split exactly where it's needed.
+    /// @tparam Task The task type: must be copyable and cheap to move
+    template<class Task>
+    class WorkStealingScheduler
+    {
+    public:
+        /// @brief A handle given to the task function to spawn more tasks on the current worker.
+        class Context
+        {
+        public:
+            /// @brief Queues a task: it runs later on this worker unless another one steals it first.
+            /// @param task The task to queue
+            void spawn(const Task& task)
+            {
+                mScheduler.push(mWorker, task);
+            }
+            
+            /// @brief Gets the index of the current worker: handy for per-worker accumulators.
+            /// @return The worker index in [0, workerCount())
+            std::size_t worker() const
+            {
+                return mWorker;
+            }
+        
+        private:
+            friend class WorkStealingScheduler;
+            
+            Context(WorkStealingScheduler& scheduler, std::size_t worker)
+            : mScheduler(scheduler), mWorker(worker) {}
+            
+            WorkStealingScheduler& mScheduler;
+            std::size_t mWorker;
+        };
+        
+        /// @brief Constructs the scheduler.
+        /// @param workers The number of worker threads, including the calling one: 0 to use the hardware concurrency
+        WorkStealingScheduler(std::size_t workers = 0)
+        : mQueues(workers ? workers : std::max(1u, std::thread::hardware_concurrency()))
+        {}
+        
+        /// @brief Gets the number of workers this scheduler runs.
+        /// @return The worker count
+        std::size_t workerCount() const
+        {
+            return mQueues.size();
+        }
+        
+        /// @brief Runs a task and everything it spawns to completion, blocking the calling thread.
+        /// @param root The initial task
+        /// @param fn The task function: called as fn(task, context)
+        /// @remarks The first exception thrown by a task is rethrown here once all workers have stopped.
+        template<class F>
+        void run(const Task& root, const F& fn)
+        {
+            mPending = 0;
+            mError = nullptr;
+            mFailed = false;
+            push(0, root);
+            
+            auto work = [&](std::size_t worker) {
+                Context context(*this, worker);
+                Task task;
+                
+                while(mPending.load(std::memory_order_acquire) != 0)
+                {
+                    if(!pop(worker, task) && !steal(worker, task))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    
+                    if(!mFailed.load(std::memory_order_relaxed))
+                    {
+                        try {
+                            fn(task, context);
+                        }
+                        catch(...)
+                        {
+                            std::lock_guard<std::mutex> lock(mErrorMutex);
+                            if(!mError)
+                                mError = std::current_exception();
+                            mFailed = true;
+                        }
+                    }
+                    
+                    // Children were counted when spawned, so this can only reach 0 once everything is done
+                    mPending.fetch_sub(1, std::memory_order_acq_rel);
+                }
+            };
+            
+            std::vector<std::thread> threads;
+            threads.reserve(mQueues.size() - 1);
+            for(std::size_t i = 1; i < mQueues.size(); i++)
+                threads.emplace_back(work, i);
+            work(0);
+            
+            for(auto& thread : threads)
+                thread.join();
+            
+            if(mError)
+                std::rethrow_exception(mError);
+        }
+    
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+        
+        void push(std::size_t worker, const Task& task)
+        {
+            mPending.fetch_add(1, std::memory_order_relaxed);
+            
+            auto& queue = mQueues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(task);
+        }
+        
+        bool pop(std::size_t worker, Task& task)
+        {
+            auto& queue = mQueues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(queue.tasks.empty())
+                return false;
+            
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+        
+        bool steal(std::size_t thief, Task& task)
+        {
+            for(std::size_t i = 1; i < mQueues.size(); i++)
+            {
+                auto& queue = mQueues[(thief + i) % mQueues.size()];
+                std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+                if(!lock || queue.tasks.empty())
+                    continue;
+                
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+            
+            return false;
+        }
+        
+        std::vector<Queue> mQueues;
+        std::atomic<std::size_t> mPending;
+        std::atomic<bool> mFailed;
+        std::mutex mErrorMutex;
+        std::exception_ptr mError;
+    };
+}
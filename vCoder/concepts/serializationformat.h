@@ -7,6 +7,7 @@
 //
 
 #pragma once
+#include <cstddef>
 #include "concept.h"
 
 namespace vcoder::concepts
@@ -17,6 +18,9 @@ namespace vcoder::concepts
     class SerializationFormat : Concept
     {
     public:
+        class Iterator;
+        class ItemsRange;
+        
         /// @brief Default-constructs the element.
         SerializationFormat();
         
@@ -33,5 +37,18 @@ namespace vcoder::concepts
         /// @brief Adds this value to this element's list (if it's an array).
         /// @param element The element to add
         void push_back(const SerializationFormat& element);
+        
+        /// @brief Checks whether this element holds no value. Used for empty optionals.
+        bool is_null() const;
+        
+        /// @brief Gets the number of subelements: used to pre-size containers before filling them.
+        std::size_t size() const;
+        
+        /// @brief Iterates over this element's list. Null elements are treated as empty lists.
+        Iterator begin() const;
+        Iterator end() const;
+        
+        /// @brief Iterates over this element's key/value pairs: each item has key() and value(). Used for string-keyed maps.
+        ItemsRange items() const;
     };
 }
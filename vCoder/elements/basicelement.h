@@ -9,15 +9,89 @@
 #pragma once
 #include <string>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <new>
+#include <string_view>
+#include <utility>
 
 #include "../common/serializable.h"
+#include "../common/cxcompare.h"
 #include "../common/polywrapper.h"
+#include "../common/arena.h"
+#include "../common/symbolmap.h"
 #include "../common/json.hpp"
 
 namespace vcoder::elements
 {
+    class BasicElement;
+    class IntervalLabeler;
+    
+    /// @brief The closed set of element kinds: lets per-kind code switch on a stored value instead of comparing type() strings.
+    enum class ElementKind : std::uint8_t
+    {
+        Root,
+        Namespace,
+        Function,
+        Type
+    };
+    
+    /// @brief Parses the name of an element kind, as returned by BasicElement::type().
+    /// @param name The name, e.g. "Function"
+    /// @param kind Receives the kind
+    /// @return Whether the name is a kind's
+    inline bool parseElementKind(std::string_view name, ElementKind& kind)
+    {
+        static constexpr std::pair<std::string_view, ElementKind> kinds[] = {
+            { "Root", ElementKind::Root },
+            { "Namespace", ElementKind::Namespace },
+            { "Function", ElementKind::Function },
+            { "Type", ElementKind::Type }
+        };
+        
+        for(auto& entry : kinds)
+            if(entry.first == name)
+            {
+                kind = entry.second;
+                return true;
+            }
+        return false;
+    }
+    
+    /// @brief An interface to receive change notifications from an element tree.
+    /// @remarks Observers are registered on the topmost element of a tree and hear about changes anywhere below it.
+    ///          Detaching a subtree by deleting it notifies from the destructor: don't call virtual members of the child then.
+    class TreeObserver
+    {
+    public:
+        virtual ~TreeObserver() {}
+        
+        /// @brief Called after a subtree has been attached to a parent.
+        /// @param parent The new parent
+        /// @param child The root of the attached subtree
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) {}
+        
+        /// @brief Called right before a subtree gets detached from its parent: it's still reachable from the root.
+        /// @param parent The current parent
+        /// @param child The root of the subtree being detached
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) {}
+        
+        /// @brief Called after an element has been renamed.
+        /// @param element The renamed element
+        /// @param oldName The element's previous name
+        virtual void onRenamed(BasicElement& element, const std::string& oldName) {}
+        
+        /// @brief Called after an element's type-specific data has changed, as reported through specificChanged().
+        /// @param element The changed element
+        virtual void onSpecificChanged(BasicElement& element) {}
+    };
+    
     /// @brief The base class for all vCoder elements.
+    /// @remarks Elements created while an ArenaScope is active are allocated from its arena, along with their names,
+    ///          child lists and child indexes: such a tree can be dropped by releasing the arena, without deleting it.
     class BasicElement
     {
     public:
@@ -59,11 +133,19 @@ namespace vcoder::elements
         
     protected:
         /// @brief Constructs a BasicElement instance.
+        /// @param kind The kind of the derived class
         /// @param name The name of this element
-        BasicElement(const std::string& name)
+        BasicElement(ElementKind kind, const std::string& name)
+        : mArena(common::Arena::current()), mName(name.data(), name.size(), mArena), mChildren(mArena), mObservers(mArena)
         {
-            mName = name;
+            mKind = kind;
             mParent = nullptr;
+            mChildIndex = nullptr;
+            mEnter = 0;
+            mExit = 0;
+            mTreeHash = 0;
+            mTreeHashValid = false;
+            mNameHash = 0;
         }
         
     public:
@@ -79,34 +161,160 @@ namespace vcoder::elements
                 child->mParent = nullptr;
                 delete child;
             }
+            
+            if(mChildIndex && mArena)
+                mChildIndex->~ChildIndex();
+            else
+                delete mChildIndex;
         }
         
         BasicElement(const BasicElement&) = delete;
-        BasicElement(BasicElement&&) = default;
+        BasicElement(BasicElement&&) = delete;
+        
+        /// @brief Allocates an element from the current arena if there's one, from the heap otherwise.
+        /// @remarks A small header records where the memory came from, so that operator delete knows what to do.
+        static void* operator new(std::size_t size)
+        {
+            auto arena = common::Arena::current();
+            auto block = static_cast<char*>(arena ? arena->allocate(size + kAllocHeader) : ::operator new(size + kAllocHeader));
+            *reinterpret_cast<common::Arena**>(block) = arena;
+            return block + kAllocHeader;
+        }
+        
+        /// @brief Frees an element allocated from the heap: arena memory is only freed along with the arena.
+        static void operator delete(void* ptr)
+        {
+            auto block = static_cast<char*>(ptr) - kAllocHeader;
+            if(!*reinterpret_cast<common::Arena**>(block))
+                ::operator delete(block);
+        }
         
         /// @brief Adds a child to this element's internal list.
         /// @param child The pointer to the child element: @b MUST be heap allocated
+        /// @remarks A child that already has a parent is moved: it gets removed from its current parent first.
         void addChild(BasicElement* child)
+        {
+            insertChild(child, nullptr);
+        }
+        
+        /// @brief Inserts a child at a given position of this element's internal list.
+        /// @param child The pointer to the child element: @b MUST be heap allocated
+        /// @param before The child to insert it before: nullptr (or an element that isn't a child) to append it
+        /// @remarks A child that already has a parent is moved: it gets removed from its current parent first.
+        void insertChild(BasicElement* child, BasicElement* before)
         {
             if(!child)
                 return;
             
-            mChildren.push_back(child);
+            if(before == child)
+                before = child->nextSibling();
+            if(before && before->mParent != this)
+                before = nullptr;
+            
+            if(child->mParent)
+                child->mParent->removeChild(child);
+            
+            child->mSiblingPos = mChildren.insert(before ? before->mSiblingPos : mChildren.end(), child);
             child->mParent = this;
+            invalidateTreeHash();
+            
+            if(mChildIndex)
+                indexChild(child);
+            else if(mChildren.size() > kChildIndexThreshold)
+                buildChildIndex();
+            
+            notify([this, child](TreeObserver& observer) { observer.onChildAdded(*this, *child); });
         }
         
         /// @brief Removes a child from this element's internal list.
         /// @param child The pointer to the child element
         void removeChild(BasicElement* child)
         {
-            mChildren.remove(child);
+            if(!child || child->mParent != this)
+                return;
+            
+            notify([this, child](TreeObserver& observer) { observer.onChildRemoving(*this, *child); });
+            
+            if(mChildIndex)
+                mChildIndex->erase(child->mNameHash, child);
+            
+            mChildren.erase(child->mSiblingPos);
             child->mParent = nullptr;
+            invalidateTreeHash();
+        }
+        
+        /// @brief Renames this element.
+        /// @param name The new name
+        void setName(const std::string& name)
+        {
+            if(std::string_view(name) == mName)
+                return;
+            
+            auto oldName = this->name();
+            mName.assign(name.data(), name.size());
+            invalidateTreeHash();
+            
+            if(mParent && mParent->mChildIndex)
+            {
+                mParent->mChildIndex->erase(mNameHash, this);
+                mParent->indexChild(this);
+            }
+            
+            notify([this, &oldName](TreeObserver& observer) { observer.onRenamed(*this, oldName); });
+        }
+        
+        /// @brief Tells the element that its type-specific data has changed: call it after mutating CX properties.
+        /// @remarks Keeps treeHash() up to date for this element and its ancestors, and notifies the tree's observers.
+        void specificChanged()
+        {
+            invalidateTreeHash();
+            notify([this](TreeObserver& observer) { observer.onSpecificChanged(*this); });
+        }
+        
+        /// @brief Registers an observer to be notified about changes in this element's tree.
+        /// @param observer The observer: must outlive its registration
+        /// @remarks Only the observers of the topmost element are notified, so register them on the tree's root.
+        void addObserver(TreeObserver* observer)
+        {
+            mObservers.push_back(observer);
+        }
+        
+        /// @brief Unregisters an observer.
+        /// @param observer The observer to unregister
+        void removeObserver(TreeObserver* observer)
+        {
+            mObservers.erase(std::remove(mObservers.begin(), mObservers.end(), observer), mObservers.end());
         }
         
         /// @brief Gets the type of this element.
         /// @return This element's type
         virtual std::string type() const = 0;
         
+        /// @brief Gets the kind of this element without a virtual call.
+        /// @return This element's kind
+        ElementKind kind() const
+        {
+            return mKind;
+        }
+        
+        /// @brief Downcasts this element to a concrete element class by comparing kinds: no RTTI involved.
+        /// @tparam T The element class: Root, Namespace, Function or Type
+        /// @return This element as a T or nullptr if it's of another kind
+        template<class T>
+        T* as()
+        {
+            return mKind == T::Kind ? static_cast<T*>(this) : nullptr;
+        }
+        
+        /// @brief Downcasts this element to a concrete element class by comparing kinds: no RTTI involved.
+        /// @tparam T The element class: Root, Namespace, Function or Type
+        /// @return This element as a T or nullptr if it's of another kind
+        template<class T>
+        const T* as() const
+        {
+            return mKind == T::Kind ? static_cast<const T*>(this) : nullptr;
+        }
+        
         /// @brief Deserializes a BasicElement from serialized data.
         /// @param data The data to recreate a BasicElement from
         static BasicElement* deserialize(const SerializationFormat& data);
@@ -123,11 +331,61 @@ namespace vcoder::elements
         /// @return The CX serializable
         virtual SerializablePtr getSpecificSerializable() = 0;
         
+        /// @brief Hashes this element's type-specific data straight from its CX properties.
+        /// @return The hash of the type-specific data
+        virtual std::size_t specificHash() const = 0;
+        
+        /// @brief Compares this element's type-specific data with another element's without serializing either.
+        /// @param other The element to compare with: elements of different types never compare equal
+        /// @return Whether the type-specific data is equal
+        virtual bool specificEquals(const BasicElement& other) const = 0;
+        
+        /// @brief Gets a Merkle hash of this element's whole subtree: type, name, type-specific data and, in order, children.
+        /// @remarks Cached per element and only recomputed for subtrees changed since the last call: mutations just mark
+        ///          the changed element and its ancestors as stale.
+        /// @return The subtree's hash
+        std::size_t treeHash() const
+        {
+            if(mTreeHashValid)
+                return mTreeHash;
+            
+            using CX::Compare::Internal::Combine;
+            auto hash = Combine(static_cast<std::size_t>(mKind), std::hash<std::string_view>()(mName));
+            hash = Combine(hash, specificHash());
+            hash = Combine(hash, mChildren.size());
+            for(auto child : mChildren)
+                hash = Combine(hash, child->treeHash());
+            
+            mTreeHash = hash;
+            mTreeHashValid = true;
+            return hash;
+        }
+        
+        /// @brief Compares two subtrees through their Merkle hashes in O(1) once both are up to date.
+        /// @param other The root of the other subtree
+        /// @param verify Whether to confirm equal hashes with a full comparison, ruling out (very unlikely) collisions
+        /// @return Whether both subtrees have the same types, names, type-specific data and children
+        bool treeEquals(const BasicElement& other, bool verify = false) const
+        {
+            if(treeHash() != other.treeHash())
+                return false;
+            if(!verify)
+                return true;
+            
+            if(mName != other.mName || mChildren.size() != other.mChildren.size() || !specificEquals(other))
+                return false;
+            
+            for(auto a = mChildren.begin(), b = other.mChildren.begin(); a != mChildren.end(); ++a, ++b)
+                if(!(*a)->treeEquals(**b, true))
+                    return false;
+            return true;
+        }
+        
         /// @brief Gets the name of this element.
         /// @return This element's name
         std::string name() const
         {
-            return mName;
+            return std::string(mName.data(), mName.size());
         }
         
         /// @brief Gets a pointer to this element's parent.
@@ -144,6 +402,152 @@ namespace vcoder::elements
             return mParent;
         }
         
+        /// @brief Gets the topmost element of the tree this element belongs to.
+        /// @return The tree's root: this element itself if it has no parent
+        BasicElement* treeRoot()
+        {
+            auto elem = this;
+            while(elem->mParent)
+                elem = elem->mParent;
+            return elem;
+        }
+        
+        /// @brief Gets the "::"-separated path to this element, e.g. vcoder::Run.
+        /// @return The qualified name: the tree's root is the global scope, so its own name isn't part of it
+        std::string qualifiedName() const
+        {
+            if(!mParent)
+                return "";
+            
+            auto prefix = mParent->qualifiedName();
+            return prefix.empty() ? name() : prefix + "::" + name();
+        }
+        
+        /// @brief Gets the label of this element's entry in the tree's Euler tour.
+        /// @remarks Only meaningful while an IntervalLabeler is attached to the tree.
+        /// @return The entry label: the labels of all descendants lie in [enter, exit)
+        std::uint64_t intervalEnter() const
+        {
+            return mEnter;
+        }
+        
+        /// @brief Gets the label of this element's exit in the tree's Euler tour.
+        /// @remarks Only meaningful while an IntervalLabeler is attached to the tree.
+        /// @return The exit label
+        std::uint64_t intervalExit() const
+        {
+            return mExit;
+        }
+        
+        /// @brief Checks whether this element is the other element or one of its ancestors in O(1).
+        /// @param other The possible descendant
+        /// @remarks Only meaningful while an IntervalLabeler is attached to the tree.
+        /// @return Whether other is inside this element's subtree
+        bool contains(const BasicElement& other) const
+        {
+            return mEnter <= other.mEnter && other.mExit <= mExit;
+        }
+        
+        /// @brief Gets a pointer to this element's first child.
+        /// @return The first child or nullptr if there are none
+        BasicElement* firstChild() const
+        {
+            return mChildren.empty() ? nullptr : mChildren.front();
+        }
+        
+        /// @brief Gets a pointer to this element's last child.
+        /// @return The last child or nullptr if there are none
+        BasicElement* lastChild() const
+        {
+            return mChildren.empty() ? nullptr : mChildren.back();
+        }
+        
+        /// @brief Gets a pointer to the next child of this element's parent in O(1).
+        /// @return The next sibling or nullptr if this is the last child (or has no parent)
+        BasicElement* nextSibling() const
+        {
+            if(!mParent)
+                return nullptr;
+            
+            auto next = std::next(mSiblingPos);
+            return next == mParent->mChildren.end() ? nullptr : *next;
+        }
+        
+        /// @brief Gets a pointer to the previous child of this element's parent in O(1).
+        /// @return The previous sibling or nullptr if this is the first child (or has no parent)
+        BasicElement* previousSibling() const
+        {
+            if(!mParent || mSiblingPos == mParent->mChildren.begin())
+                return nullptr;
+            
+            return *std::prev(mSiblingPos);
+        }
+        
+        /// @brief Gets the number of direct children of this element.
+        /// @return The number of children
+        std::size_t childCount() const
+        {
+            return mChildren.size();
+        }
+        
+        /// @brief Finds a direct child by name.
+        /// @param name The child's name
+        /// @return The child or nullptr if there's none: if several children share the name, any of them
+        /// @remarks O(1) on average once the element has more than kChildIndexThreshold children, a linear scan otherwise.
+        BasicElement* findChild(std::string_view name) const
+        {
+            if(!mChildIndex)
+            {
+                for(auto child : mChildren)
+                    if(child->mName == name)
+                        return child;
+                return nullptr;
+            }
+            
+            BasicElement* result = nullptr;
+            mChildIndex->forEach(nameHash(name), [&result, name](BasicElement* child) {
+                if(!result && child->mName == name)
+                    result = child;
+            });
+            return result;
+        }
+        
+        /// @brief Invokes the callback for every direct child with a given name, in no particular order.
+        /// @param name The children's name
+        /// @param fn The callback: must accept one argument of type BasicElement&
+        /// @remarks Uses the child index like findChild() does.
+        template<class F>
+        void forEachChildNamed(std::string_view name, const F& fn) const
+        {
+            if(!mChildIndex)
+            {
+                for(auto child : mChildren)
+                    if(child->mName == name)
+                        fn(*child);
+                return;
+            }
+            
+            mChildIndex->forEach(nameHash(name), [&fn, name](BasicElement* child) {
+                if(child->mName == name)
+                    fn(*child);
+            });
+        }
+        
+        /// @brief Resolves a "::"-separated path relative to this element, e.g. vcoder::Run, one level at a time.
+        /// @param path The path: an empty one resolves to this element itself
+        /// @return The element found or nullptr
+        BasicElement* resolve(std::string_view path)
+        {
+            auto elem = this;
+            while(elem && !path.empty())
+            {
+                auto separator = path.find("::");
+                elem = elem->findChild(path.substr(0, separator));
+                path = separator == path.npos ? std::string_view() : path.substr(separator + 2);
+            }
+            return elem;
+        }
+        
         /// @brief Invokes the specified callback for all children.
         /// @param callback The callback to invoke: must accept one argument of type BasicElement&
         template<class F>
@@ -152,9 +556,63 @@ namespace vcoder::elements
             for(auto& child : mChildren)
                 callback(*child);
         }
+        /// @brief The number of children above which an element indexes them by name.
+        static constexpr std::size_t kChildIndexThreshold = 16;
+        
     private:
-        std::string mName;
+        using String = std::basic_string<char, std::char_traits<char>, common::ArenaAllocator<char>>;
+        using ChildIndex = common::SymbolMultiMap<BasicElement*>; // Keyed by name hash: names are compared on hits
+        
+        static constexpr std::size_t kAllocHeader = alignof(std::max_align_t);
+        
+        friend class IntervalLabeler;
+        
+        /// @brief Hashes a name for the child index: no table involved, so separate trees share no state.
+        static std::uint32_t nameHash(std::string_view name)
+        {
+            return static_cast<std::uint32_t>(std::hash<std::string_view>()(name));
+        }
+        
+        void indexChild(BasicElement* child)
+        {
+            child->mNameHash = nameHash(child->mName);
+            mChildIndex->insert(child->mNameHash, child);
+        }
+        
+        void buildChildIndex()
+        {
+            mChildIndex = mArena ? new(mArena->allocate(sizeof(ChildIndex))) ChildIndex(mArena) : new ChildIndex();
+            for(auto child : mChildren)
+                indexChild(child);
+        }
+        
+        /// @brief Marks the cached tree hashes of this element and its ancestors as stale.
+        /// @remarks A stale element always has stale ancestors, so the walk stops at the first one already stale.
+        void invalidateTreeHash()
+        {
+            for(auto elem = this; elem && elem->mTreeHashValid; elem = elem->mParent)
+                elem->mTreeHashValid = false;
+        }
+        
+        template<class F>
+        void notify(const F& fn)
+        {
+            auto root = treeRoot();
+            for(auto observer : root->mObservers)
+                fn(*observer);
+        }
+        
+        common::Arena* mArena; // The arena this element was created in or nullptr
+        ElementKind mKind;
+        String mName;
         BasicElement* mParent;
-        std::list<BasicElement*> mChildren;
+        std::list<BasicElement*, common::ArenaAllocator<BasicElement*>> mChildren;
+        std::list<BasicElement*, common::ArenaAllocator<BasicElement*>>::iterator mSiblingPos; // Position in the parent's mChildren: valid while mParent is set
+        std::vector<TreeObserver*, common::ArenaAllocator<TreeObserver*>> mObservers; // Only used on the topmost element
+        std::uint64_t mEnter, mExit; // Euler tour labels: maintained by IntervalLabeler
+        mutable std::size_t mTreeHash; // Merkle hash of the subtree: valid while mTreeHashValid is set
+        mutable bool mTreeHashValid;
+        ChildIndex* mChildIndex; // Children by name: only built for large fan-outs
+        std::uint32_t mNameHash; // The name's hash: valid while the parent has a child index
     };
 }
@@ -13,6 +13,8 @@
 #include "function.h"
 #include "type.h"
 #include "namespace.h"
+#include "traversal.h"
+#include "visitor.h"
 
 #define VELEM_STR(x) #x
 
@@ -25,6 +27,13 @@ if(type == VELEM_STR(T)) \
 
 namespace vcoder::elements
 {
+    // Releasing an arena doesn't run destructors, so element properties must not own memory of their own
+    static_assert(CX::Reflection::Internal::HasTriviallyDestructibleProperties<Root>() &&
+                  CX::Reflection::Internal::HasTriviallyDestructibleProperties<Namespace>() &&
+                  CX::Reflection::Internal::HasTriviallyDestructibleProperties<Function>() &&
+                  CX::Reflection::Internal::HasTriviallyDestructibleProperties<Type>(),
+                  "Element CX properties must be trivially destructible: arena-allocated elements aren't destroyed");
+    
     BasicElement* BasicElement::deserialize(const SerializationFormat& data)
     {
         auto name = data["name"].template get<std::string>();
@@ -39,7 +48,7 @@ namespace vcoder::elements
         
         if(ptr)
         {
-            ptr->mName = name;
+            ptr->mName.assign(name.data(), name.size());
             
             if(data.find("children") != data.end())
                 for(auto& child : data["children"])
@@ -16,8 +16,11 @@ namespace vcoder::elements
     class Function : public BasicElement
     {
     public:
+        /// @brief The kind every Function has.
+        static constexpr ElementKind Kind = ElementKind::Function;
+        
         /// @brief Constructs the function element.
-        Function(const std::string& name = "") : BasicElement(name)
+        Function(const std::string& name = "") : BasicElement(Kind, name)
         {}
         
         /// @brief Implements BasicElement::getSerializable().
@@ -34,6 +37,22 @@ namespace vcoder::elements
             return "Function";
         }
         
+        /// @brief Implements BasicElement::specificHash().
+        /// @return The hash of this element's CX properties
+        virtual std::size_t specificHash() const override
+        {
+            return CX::Hash(*this);
+        }
+        
+        /// @brief Implements BasicElement::specificEquals().
+        /// @param other The element to compare with
+        /// @return Whether both elements are Functions with equal CX properties
+        virtual bool specificEquals(const BasicElement& other) const override
+        {
+            auto that = other.as<Function>();
+            return that && CX::Equal(*this, *that);
+        }
+        
         CXPROPS(Function) (
                        CXPROP(isFunction)
                        ) CXPROPS_END;
@@ -0,0 +1,347 @@
+//
+//  fuzzysearch.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "basicelement.h"
+#include "traversal.h"
+
+namespace vcoder::elements
+{
+    /// @brief Fuzzy search over qualified element names: "vrun" finds vcoder::Run.
+    /// @remarks Names are packed into one contiguous buffer along with a 64-bit mask of the character classes each one
+    ///          contains. A search first drops every name missing one of the pattern's classes, then scores the survivors
+    ///          by matching the pattern as a subsequence. Both steps are vectorized with SSE2 on x86-64 and NEON on arm64,
+    ///          testing two masks and scanning 16 bytes per step; other targets scan 8 bytes per step with plain 64-bit
+    ///          arithmetic. The buffer is rebuilt lazily on the first search after a tree change.
+    class FuzzySearch : public TreeObserver
+    {
+    public:
+        /// @brief A search result.
+        struct Match
+        {
+            BasicElement* element;
+            int score;
+        };
+        
+        FuzzySearch()
+        : mRoot(nullptr), mValid(false) {}
+        
+        FuzzySearch(const FuzzySearch&) = delete;
+        
+        ~FuzzySearch()
+        {
+            detach();
+        }
+        
+        /// @brief Packs a tree's names and starts tracking its changes.
+        /// @param root The tree's topmost element: the global scope
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            build();
+        }
+        
+        /// @brief Stops tracking the tree and frees the buffer.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mValid = false;
+            mBuffer.clear();
+            mOffsets.clear();
+            mMasks.clear();
+            mElements.clear();
+        }
+        
+        /// @brief Finds the elements whose qualified name best matches a pattern.
+        /// @param pattern The pattern: its characters must appear in the name in order, case-insensitively
+        /// @param limit The maximum number of results
+        /// @param workers The number of threads to scan with: 0 to use the hardware concurrency
+        /// @return The best matches, best first
+        std::vector<Match> search(std::string_view pattern, std::size_t limit, std::size_t workers = 1)
+        {
+            if(!mValid)
+                build();
+            
+            std::vector<Match> result;
+            if(limit == 0 || pattern.empty() || mElements.empty())
+                return result;
+            
+            if(workers == 0)
+                workers = std::max(1u, std::thread::hardware_concurrency());
+            workers = std::min(workers, (mElements.size() + kMinChunk - 1) / kMinChunk);
+            
+            // Each worker keeps its own top-k of a contiguous slice: merged once everything is scanned
+            auto patternMask = maskOf(pattern);
+            std::vector<std::vector<Match>> partials(workers);
+            auto scan = [&](std::size_t worker) {
+                auto first = mElements.size() * worker / workers;
+                auto last = mElements.size() * (worker + 1) / workers;
+                partials[worker] = scanRange(pattern, patternMask, first, last, limit);
+            };
+            
+            std::vector<std::thread> threads;
+            for(std::size_t i = 1; i < workers; i++)
+                threads.emplace_back(scan, i);
+            scan(0);
+            for(auto& thread : threads)
+                thread.join();
+            
+            for(auto& partial : partials)
+                result.insert(result.end(), partial.begin(), partial.end());
+            std::sort(result.begin(), result.end(), [](const Match& a, const Match& b) { return a.score > b.score; });
+            if(result.size() > limit)
+                result.resize(limit);
+            return result;
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            mValid = false;
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            mValid = false;
+        }
+        
+        virtual void onRenamed(BasicElement& element, const std::string& oldName) override
+        {
+            mValid = false;
+        }
+    
+    private:
+        static constexpr std::size_t kMinChunk = 4096;
+        static constexpr std::size_t kPadding = 16; // Lets the last name be loaded 16 bytes at a time
+        
+        /// @brief Maps a character to its class: letters (case-insensitive), digits, '_' and everything else.
+        static std::uint64_t classOf(char c)
+        {
+            auto u = static_cast<unsigned char>(c);
+            if(std::isalpha(u))
+                return std::uint64_t(1) << (std::tolower(u) - 'a');
+            if(std::isdigit(u))
+                return std::uint64_t(1) << (26 + u - '0');
+            return std::uint64_t(1) << (c == '_' ? 36 : 37);
+        }
+        
+        static std::uint64_t maskOf(std::string_view str)
+        {
+            std::uint64_t mask = 0;
+            for(auto c : str)
+                mask |= classOf(c);
+            return mask;
+        }
+        
+        /// @brief Finds the first occurrence of a character in [it, end), ignoring case for letters.
+        static const char* findChar(const char* it, const char* end, char c)
+        {
+            auto letter = std::isalpha(static_cast<unsigned char>(c)) != 0;
+            auto target = static_cast<char>(letter ? (c | 0x20) : c);
+
+#if defined(__SSE2__)
+            // Setting bit 5 lowercases letters: only applied when looking for one
+            auto needle = _mm_set1_epi8(target);
+            auto fold = _mm_set1_epi8(letter ? 0x20 : 0);
+            for(; it < end; it += 16)
+            {
+                auto chunk = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(it)), fold);
+                auto bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+                if(bits)
+                    return std::min(it + __builtin_ctz(bits), end);
+            }
+            return end;
+#elif defined(__ARM_NEON)
+            auto needle = vdupq_n_u8(static_cast<std::uint8_t>(target));
+            auto fold = vdupq_n_u8(letter ? 0x20 : 0);
+            for(; it < end; it += 16)
+            {
+                auto chunk = vorrq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t*>(it)), fold);
+                
+                // No movemask on NEON: narrowing the comparison leaves 4 bits per byte in a 64-bit scalar
+                auto equal = vreinterpretq_u16_u8(vceqq_u8(chunk, needle));
+                auto bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(equal, 4)), 0);
+                if(bits)
+                    return std::min(it + __builtin_ctzll(bits) / 4, end);
+            }
+            return end;
+#else
+            // 8 bytes at a time: a byte of word ^ needle is zero where the character matches
+            const std::uint64_t ones = 0x0101010101010101;
+            auto needle = ones * static_cast<unsigned char>(target);
+            auto fold = letter ? ones * 0x20 : 0;
+            for(; it < end; it += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, it, sizeof(word));
+                word = (word | fold) ^ needle;
+                if(((word - ones) & ~word & (ones << 7)) == 0)
+                    continue;
+                
+                // The test is exact about whether the word holds a match but not about where: found bytewise
+                for(auto last = std::min(it + 8, end); it < last; ++it)
+                    if((letter ? (*it | 0x20) : *it) == target)
+                        return it;
+                return end;
+            }
+            return end;
+#endif
+        }
+        
+        /// @brief Scores a name by matching the pattern as a subsequence: 0 if it doesn't match.
+        /// @remarks Matches at the start of a word (after ::, _ or a lowercase letter) and consecutive matches score
+        ///          higher; gaps and long names score lower.
+        static int score(std::string_view pattern, const char* name, const char* end)
+        {
+            int result = 1;
+            const char* prev = nullptr;
+            auto it = name;
+            
+            for(auto c : pattern)
+            {
+                it = findChar(it, end, c);
+                if(it == end)
+                    return 0;
+                
+                auto before = it == name ? ':' : it[-1];
+                if(before == ':' || before == '_' || (std::isupper(static_cast<unsigned char>(*it)) && std::islower(static_cast<unsigned char>(before))))
+                    result += 8;
+                if(prev && it == prev + 1)
+                    result += 5;
+                else if(prev)
+                    result -= static_cast<int>(std::min<std::ptrdiff_t>(it - prev - 1, 3));
+                
+                result += 2;
+                prev = it++;
+            }
+            
+            return std::max(1, result - static_cast<int>((end - name) / 8));
+        }
+        
+        std::vector<Match> scanRange(std::string_view pattern, std::uint64_t patternMask, std::size_t first, std::size_t last, std::size_t limit) const
+        {
+            // Min-heap on score: its top is the worst of the current best
+            auto worse = [](const Match& a, const Match& b) { return a.score > b.score; };
+            std::priority_queue<Match, std::vector<Match>, decltype(worse)> best(worse);
+            
+            auto consider = [&](std::size_t i) {
+                auto value = score(pattern, &mBuffer[mOffsets[i]], &mBuffer[mOffsets[i + 1] - 1]);
+                if(value == 0 || (best.size() == limit && value <= best.top().score))
+                    return;
+                
+                best.push({ mElements[i], value });
+                if(best.size() > limit)
+                    best.pop();
+            };
+            
+            auto i = first;
+#if defined(__SSE2__)
+            // A name can only match if it contains every character class of the pattern: test two masks at a time
+            auto wanted = _mm_set1_epi64x(static_cast<long long>(patternMask));
+            for(; i + 2 <= last; i += 2)
+            {
+                auto masks = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mMasks[i]));
+                auto missing = _mm_andnot_si128(masks, wanted);
+                auto zero = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(missing, _mm_setzero_si128())));
+                if((zero & 0x00FF) == 0x00FF)
+                    consider(i);
+                if((zero & 0xFF00) == 0xFF00)
+                    consider(i + 1);
+            }
+#elif defined(__ARM_NEON)
+            auto wanted = vdupq_n_u64(patternMask);
+            for(; i + 2 <= last; i += 2)
+            {
+                auto missing = vbicq_u64(wanted, vld1q_u64(&mMasks[i]));
+                if(vgetq_lane_u64(missing, 0) == 0)
+                    consider(i);
+                if(vgetq_lane_u64(missing, 1) == 0)
+                    consider(i + 1);
+            }
+#endif
+            for(; i < last; i++)
+                if((patternMask & ~mMasks[i]) == 0)
+                    consider(i);
+            
+            std::vector<Match> result;
+            result.reserve(best.size());
+            for(; !best.empty(); best.pop())
+                result.push_back(best.top());
+            return result;
+        }
+        
+        void build()
+        {
+            mBuffer.clear();
+            mOffsets.clear();
+            mMasks.clear();
+            mElements.clear();
+            mValid = true;
+            
+            if(!mRoot)
+                return;
+            
+            // Qualified names are built incrementally: each one extends its parent's
+            std::string name;
+            std::vector<std::size_t> lengths;
+            auto range = preOrder(*mRoot);
+            for(auto it = range.begin(); it != range.end(); ++it)
+            {
+                auto depth = it.depth();
+                if(depth == 0)
+                {
+                    lengths.assign(1, 0);
+                    continue;
+                }
+                
+                name.resize(lengths[depth - 1]);
+                if(!name.empty())
+                    name += "::";
+                name += it->name();
+                lengths.resize(depth + 1);
+                lengths[depth] = name.size();
+                
+                // Names are NUL-separated: offsets[i + 1] - 1 is the end of name i
+                mOffsets.push_back(static_cast<std::uint32_t>(mBuffer.size()));
+                mBuffer.append(name).push_back('\0');
+                mMasks.push_back(maskOf(name));
+                mElements.push_back(&*it);
+            }
+            
+            mOffsets.push_back(static_cast<std::uint32_t>(mBuffer.size()));
+            mBuffer.append(kPadding, '\0');
+        }
+        
+        BasicElement* mRoot;
+        bool mValid;
+        std::string mBuffer;
+        std::vector<std::uint32_t> mOffsets;
+        std::vector<std::uint64_t> mMasks;
+        std::vector<BasicElement*> mElements;
+    };
+}
@@ -0,0 +1,97 @@
+//
+//  handletable.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+
+namespace vcoder::elements
+{
+    /// @brief A dense element id: indexes arrays directly, unlike a pointer.
+    using Handle = std::uint32_t;
+    
+    /// @brief The handle of no element.
+    constexpr Handle kNoHandle = UINT32_MAX;
+    
+    /// @brief Hands out dense handles to elements and maps them back.
+    /// @remarks Released handles are reused first, so handles stay below the peak number of live ones. A handle stays
+    ///          valid until released: release it before deleting its element.
+    class HandleTable
+    {
+    public:
+        /// @brief Gets an element's handle, giving it one if it has none yet.
+        /// @param elem The element
+        /// @return The handle
+        Handle acquire(BasicElement& elem)
+        {
+            auto found = mHandles.find(&elem);
+            if(found != mHandles.end())
+                return found->second;
+            
+            Handle handle;
+            if(!mFree.empty())
+            {
+                handle = mFree.back();
+                mFree.pop_back();
+                mElements[handle] = &elem;
+            }
+            else
+            {
+                handle = Handle(mElements.size());
+                mElements.push_back(&elem);
+            }
+            
+            mHandles.emplace(&elem, handle);
+            return handle;
+        }
+        
+        /// @brief Gets an element's handle.
+        /// @param elem The element
+        /// @return The handle or kNoHandle if it has none
+        Handle find(const BasicElement& elem) const
+        {
+            auto found = mHandles.find(&elem);
+            return found == mHandles.end() ? kNoHandle : found->second;
+        }
+        
+        /// @brief Gets the element a handle stands for.
+        /// @param handle The handle
+        /// @return The element or nullptr if the handle isn't in use
+        BasicElement* element(Handle handle) const
+        {
+            return handle < mElements.size() ? mElements[handle] : nullptr;
+        }
+        
+        /// @brief Frees an element's handle for reuse.
+        /// @param elem The element
+        void release(const BasicElement& elem)
+        {
+            auto found = mHandles.find(&elem);
+            if(found == mHandles.end())
+                return;
+            
+            mElements[found->second] = nullptr;
+            mFree.push_back(found->second);
+            mHandles.erase(found);
+        }
+        
+        /// @brief Gets the bound of the handles handed out so far.
+        /// @return The smallest value above every handle in use: arrays indexed by handle need this many slots
+        std::size_t capacity() const
+        {
+            return mElements.size();
+        }
+    
+    private:
+        std::vector<BasicElement*> mElements; // By handle: nullptr for free ones
+        std::unordered_map<const BasicElement*, Handle> mHandles;
+        std::vector<Handle> mFree;
+    };
+}
@@ -0,0 +1,162 @@
+//
+//  intervallabels.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "basicelement.h"
+#include "traversal.h"
+
+namespace vcoder::elements
+{
+    /// @brief Maintains Euler tour interval labels on an element tree for O(1) ancestor tests and subtree ranges.
+    /// @remarks Every element gets [enter, exit) labels nested inside its parent's. Labels are spread over a 62-bit
+    ///          space with gaps between them, so an inserted subtree usually fits between its siblings without
+    ///          touching anything else. When a gap runs out, the smallest enclosing subtree that is at most a
+    ///          quarter full is relabeled evenly: relabeling keeps the relative order of all labels.
+    class IntervalLabeler : public TreeObserver
+    {
+    public:
+        IntervalLabeler()
+        : mRoot(nullptr), mRelabelCount(0) {}
+        
+        IntervalLabeler(const IntervalLabeler&) = delete;
+        
+        ~IntervalLabeler()
+        {
+            detach();
+        }
+        
+        /// @brief Labels a tree in one pass and starts tracking its changes.
+        /// @param root The tree's topmost element
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            
+            root.mEnter = 0;
+            root.mExit = kLabelSpace;
+            relabel(root, subtreeSize(root));
+        }
+        
+        /// @brief Stops tracking the tree: its labels are left as they are but won't be updated anymore.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            mRoot = nullptr;
+        }
+        
+        /// @brief Gets the tree this labeler is attached to.
+        /// @return The tree's topmost element or nullptr
+        BasicElement* root() const
+        {
+            return mRoot;
+        }
+        
+        /// @brief Gets the number of times an insert didn't fit its gap and an enclosing subtree had to be relabeled.
+        /// @return The number of relabelings
+        std::size_t relabelCount() const
+        {
+            return mRelabelCount;
+        }
+        
+        /// @brief Checks whether one element is an ancestor of (or the same as) another: two integer comparisons.
+        /// @param ancestor The possible ancestor
+        /// @param descendant The possible descendant
+        /// @return Whether descendant is inside ancestor's subtree
+        static bool isAncestorOf(const BasicElement& ancestor, const BasicElement& descendant)
+        {
+            return ancestor.contains(descendant);
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            auto size = subtreeSize(child);
+            
+            // Try the gap between the child's neighbours first: use its middle half to leave room on both sides
+            auto prev = child.previousSibling();
+            auto next = child.nextSibling();
+            auto lo = prev ? prev->mExit : parent.mEnter;
+            auto hi = next ? next->mEnter : parent.mExit;
+            
+            if(hi - lo > 4 * size)
+            {
+                auto quarter = (hi - lo) / 4;
+                child.mEnter = lo + quarter;
+                child.mExit = hi - quarter;
+                relabel(child, size);
+                return;
+            }
+            
+            // Find the closest ancestor with enough room and spread its whole subtree evenly. Sizes are accumulated
+            // while climbing, each scope adding itself and its other children to the one below: O(relabeled subtree)
+            std::uint64_t scopeSize = 0;
+            BasicElement* below = nullptr;
+            for(auto scope = &parent; scope; below = scope, scope = scope->parent())
+            {
+                scopeSize++;
+                for(auto sibling = scope->firstChild(); sibling; sibling = sibling->nextSibling())
+                    if(sibling != below)
+                        scopeSize += subtreeSize(*sibling);
+                
+                if(scope == mRoot || scope->mExit - scope->mEnter > 8 * scopeSize)
+                {
+                    mRelabelCount++;
+                    relabel(*scope, scopeSize);
+                    return;
+                }
+            }
+        }
+    
+    private:
+        static constexpr std::uint64_t kLabelSpace = std::uint64_t(1) << 62;
+        
+        static std::uint64_t subtreeSize(BasicElement& top)
+        {
+            std::uint64_t size = 0;
+            for(auto& elem : preOrder(top))
+            {
+                (void)elem;
+                size++;
+            }
+            return size;
+        }
+        
+        /// @brief Spreads the labels of a subtree's descendants evenly inside the subtree root's own interval.
+        /// @param top The subtree's root: its labels are kept
+        /// @param size The number of elements in the subtree
+        void relabel(BasicElement& top, std::uint64_t size)
+        {
+            // 2 labels per descendant: the gap leaves room for the same amount again before the next relabel
+            auto gap = (top.mExit - top.mEnter) / (2 * size);
+            auto label = top.mEnter;
+            std::vector<BasicElement*> open; // Ancestors of the current element, by depth
+            
+            auto range = preOrder(top);
+            for(auto it = range.begin(); it != range.end(); ++it)
+            {
+                // Everything deeper than the current element has been fully visited: close it
+                for(; open.size() > it.depth(); open.pop_back())
+                    if(open.size() > 1)
+                        open.back()->mExit = (label += gap);
+                
+                if(it.depth() > 0)
+                    it->mEnter = (label += gap);
+                open.push_back(&*it);
+            }
+            
+            for(; open.size() > 1; open.pop_back())
+                open.back()->mExit = (label += gap);
+        }
+        
+        BasicElement* mRoot;
+        std::size_t mRelabelCount;
+    };
+}
@@ -0,0 +1,259 @@
+//
+//  kindindex.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+#include "traversal.h"
+#include "intervallabels.h"
+
+namespace vcoder::elements
+{
+    /// @brief Per-kind membership sets ("every Function", "every Type under vcoder"), kept up to date as the tree changes.
+    /// @remarks Each kind is a dense array with O(1) insertion and swap-removal. Subtree queries use the interval labels
+    ///          maintained by an IntervalLabeler: every element of a subtree has its entry label in [enter, exit) of
+    ///          the subtree's root, so the kind's members sorted by entry label answer them with a binary search.
+    ///          Relabeling preserves order, so the sorted views are kept up to date incrementally: added members wait in
+    ///          a buffer until the next query places them at their lower bound, and a removed subtree's members are
+    ///          erased as the one contiguous run they form.
+    class KindIndex : public TreeObserver
+    {
+    public:
+        KindIndex()
+        : mRoot(nullptr), mLabels(nullptr) {}
+        
+        KindIndex(const KindIndex&) = delete;
+        
+        ~KindIndex()
+        {
+            detach();
+        }
+        
+        /// @brief Indexes a tree and starts tracking its changes.
+        /// @param root The tree's topmost element
+        /// @param labels The labeler maintaining the tree's interval labels, for subtree queries: must outlive the index
+        void attach(BasicElement& root, const IntervalLabeler& labels)
+        {
+            detach();
+            mRoot = &root;
+            mLabels = &labels;
+            mRoot->addObserver(this);
+            insertSubtree(root);
+        }
+        
+        /// @brief Stops tracking the tree and clears the index.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mLabels = nullptr;
+            mKinds.clear();
+            mSlots.clear();
+        }
+        
+        /// @brief Gets every element of a kind, in no particular order.
+        /// @param kind The kind
+        /// @return The elements of that kind: invalidated by the next change to the tree
+        const std::vector<BasicElement*>& all(ElementKind kind) const
+        {
+            static const std::vector<BasicElement*> empty;
+            auto index = static_cast<std::size_t>(kind);
+            return index < mKinds.size() ? mKinds[index].members : empty;
+        }
+        
+        /// @brief Counts the elements of a kind in O(1).
+        /// @param kind The kind
+        /// @return The number of elements of that kind
+        std::size_t count(ElementKind kind) const
+        {
+            return all(kind).size();
+        }
+        
+        /// @brief Invokes the callback for every element of a kind inside a subtree (the scope itself included).
+        /// @param kind The kind
+        /// @param scope The root of the subtree: must belong to the indexed tree
+        /// @param fn The callback: must accept one argument of type BasicElement&
+        /// @remarks Costs O(log n + results), plus placing the members added since the last query. Throws
+        ///          std::logic_error if the labeler passed to attach() isn't attached to the indexed tree anymore, as the
+        ///          labels may be stale.
+        template<class F>
+        void forEachIn(ElementKind kind, const BasicElement& scope, const F& fn)
+        {
+            if(!labelsMaintained())
+                throw std::logic_error("The indexed tree's interval labels aren't maintained");
+            
+            auto index = static_cast<std::size_t>(kind);
+            if(index >= mKinds.size())
+                return;
+            
+            auto& sorted = sortedView(mKinds[index]);
+            auto first = std::lower_bound(sorted.begin(), sorted.end(), scope.intervalEnter(),
+                                          [](const BasicElement* elem, std::uint64_t enter) {
+                                              return elem->intervalEnter() < enter;
+                                          });
+            
+            for(; first != sorted.end() && (*first)->intervalEnter() < scope.intervalExit(); ++first)
+                fn(**first);
+        }
+        
+        /// @brief Collects every element of a kind inside a subtree (the scope itself included), in pre-order.
+        /// @param kind The kind
+        /// @param scope The root of the subtree: must belong to the indexed tree
+        /// @return The elements found
+        std::vector<BasicElement*> findIn(ElementKind kind, const BasicElement& scope)
+        {
+            std::vector<BasicElement*> result;
+            forEachIn(kind, scope, [&result](BasicElement& elem) { result.push_back(&elem); });
+            return result;
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            insertSubtree(child);
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            // The subtree's placed members are contiguous in every sorted view, as long as the labels are up to date
+            auto labeled = labelsMaintained();
+            for(auto& kind : mKinds)
+            {
+                if(!labeled)
+                    kind.sortedValid = false;
+                else if(kind.sortedValid)
+                    kind.sorted.erase(lowerBound(kind.sorted, child.intervalEnter()), lowerBound(kind.sorted, child.intervalExit()));
+            }
+            
+            // The kind is looked up from the slot: the child may be halfway through its destructor here
+            for(auto& elem : preOrder(child))
+                erase(&elem);
+        }
+    
+    private:
+        struct Kind
+        {
+            std::vector<BasicElement*> members;
+            std::vector<BasicElement*> sorted;  // Placed members by entry label
+            std::vector<BasicElement*> pending; // Members added since the last query: not in sorted yet
+            bool sortedValid = false;           // Cleared when sorted has to be rebuilt from members
+        };
+        
+        struct Slot
+        {
+            std::uint32_t kind;
+            std::uint32_t position;
+            std::uint32_t pending; // Position in the kind's pending members or kPlaced
+        };
+        
+        static constexpr std::uint32_t kPlaced = UINT32_MAX;
+        
+        bool labelsMaintained() const
+        {
+            return mLabels && mRoot && mLabels->root() == mRoot;
+        }
+        
+        static std::vector<BasicElement*>::iterator lowerBound(std::vector<BasicElement*>& sorted, std::uint64_t label)
+        {
+            return std::lower_bound(sorted.begin(), sorted.end(), label, [](const BasicElement* elem, std::uint64_t label) {
+                return elem->intervalEnter() < label;
+            });
+        }
+        
+        void insertSubtree(BasicElement& top)
+        {
+            for(auto& elem : preOrder(top))
+            {
+                auto kind = static_cast<std::uint32_t>(elem.kind());
+                if(kind >= mKinds.size())
+                    mKinds.resize(kind + 1);
+                
+                // Members of a kind without a sorted view yet are sorted along with the others when it's built
+                auto& entry = mKinds[kind];
+                auto pending = entry.sortedValid ? static_cast<std::uint32_t>(entry.pending.size()) : kPlaced;
+                mSlots[&elem] = { kind, static_cast<std::uint32_t>(entry.members.size()), pending };
+                entry.members.push_back(&elem);
+                if(entry.sortedValid)
+                    entry.pending.push_back(&elem);
+            }
+        }
+        
+        void erase(BasicElement* elem)
+        {
+            auto slot = mSlots.find(elem);
+            if(slot == mSlots.end())
+                return;
+            
+            // Swap-remove: move the last member into the freed position
+            auto& kind = mKinds[slot->second.kind];
+            auto moved = kind.members.back();
+            kind.members[slot->second.position] = moved;
+            mSlots[moved].position = slot->second.position;
+            kind.members.pop_back();
+            
+            if(slot->second.pending != kPlaced)
+            {
+                moved = kind.pending.back();
+                kind.pending[slot->second.pending] = moved;
+                mSlots[moved].pending = slot->second.pending;
+                kind.pending.pop_back();
+            }
+            mSlots.erase(slot);
+        }
+        
+        const std::vector<BasicElement*>& sortedView(Kind& kind)
+        {
+            auto byLabel = [](const BasicElement* a, const BasicElement* b) {
+                return a->intervalEnter() < b->intervalEnter();
+            };
+            
+            if(!kind.sortedValid)
+            {
+                // Rebuilt from scratch: only on the first query, or after the labels went unmaintained
+                kind.sorted = kind.members;
+                std::sort(kind.sorted.begin(), kind.sorted.end(), byLabel);
+                kind.sortedValid = true;
+            }
+            else if(kind.pending.size() * 8 < kind.sorted.size())
+            {
+                // A few added subtrees: each is a run of consecutive labels, inserted where it belongs
+                std::sort(kind.pending.begin(), kind.pending.end(), byLabel);
+                for(auto run = kind.pending.begin(); run != kind.pending.end();)
+                {
+                    auto at = lowerBound(kind.sorted, (*run)->intervalEnter());
+                    auto end = run + 1;
+                    while(end != kind.pending.end() && (at == kind.sorted.end() || byLabel(*end, *at)))
+                        ++end;
+                    kind.sorted.insert(at, run, end);
+                    run = end;
+                }
+            }
+            else if(!kind.pending.empty())
+            {
+                std::sort(kind.pending.begin(), kind.pending.end(), byLabel);
+                auto middle = kind.sorted.insert(kind.sorted.end(), kind.pending.begin(), kind.pending.end());
+                std::inplace_merge(kind.sorted.begin(), middle, kind.sorted.end(), byLabel);
+            }
+            
+            for(auto elem : kind.pending)
+                mSlots[elem].pending = kPlaced;
+            kind.pending.clear();
+            return kind.sorted;
+        }
+        
+        BasicElement* mRoot;
+        const IntervalLabeler* mLabels;
+        std::vector<Kind> mKinds; // By ElementKind
+        std::unordered_map<const BasicElement*, Slot> mSlots;
+    };
+}
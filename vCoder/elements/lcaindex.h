@@ -0,0 +1,177 @@
+//
+//  lcaindex.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+#include "traversal.h"
+
+namespace vcoder::elements
+{
+    /// @brief Answers lowest common ancestor queries ("nearest shared enclosing scope") in O(1).
+    /// @remarks Built from the tree's Euler tour: the LCA of two elements is the shallowest element visited between their
+    ///          first occurrences, found with a sparse table of range minimums. Building costs O(n log n); any change to
+    ///          the tree only marks the index as stale and the next query rebuilds it, so batches of edits stay cheap.
+    class LcaIndex : public TreeObserver
+    {
+    public:
+        LcaIndex()
+        : mRoot(nullptr), mValid(false) {}
+        
+        LcaIndex(const LcaIndex&) = delete;
+        
+        ~LcaIndex()
+        {
+            detach();
+        }
+        
+        /// @brief Indexes a tree and starts tracking its changes.
+        /// @param root The tree's topmost element
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            build();
+        }
+        
+        /// @brief Stops tracking the tree and clears the index.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mValid = false;
+            mTour.clear();
+            mDepths.clear();
+            mFirst.clear();
+            mTable.clear();
+        }
+        
+        /// @brief Finds the lowest common ancestor of two elements: an element counts as its own ancestor.
+        /// @param a The first element
+        /// @param b The second element
+        /// @return The deepest element enclosing both or nullptr if either isn't part of the indexed tree
+        BasicElement* lca(const BasicElement& a, const BasicElement& b)
+        {
+            if(!mValid)
+                build();
+            
+            auto first = mFirst.find(&a);
+            auto second = mFirst.find(&b);
+            if(first == mFirst.end() || second == mFirst.end())
+                return nullptr;
+            
+            auto lo = first->second;
+            auto hi = second->second;
+            if(lo > hi)
+                std::swap(lo, hi);
+            
+            // Two overlapping power-of-two ranges cover [lo, hi]
+            auto level = log2(hi - lo + 1);
+            auto left = mTable[level][lo];
+            auto right = mTable[level][hi - (std::uint32_t(1) << level) + 1];
+            return mTour[mDepths[left] <= mDepths[right] ? left : right];
+        }
+        
+        /// @brief Gets the depth of an element below the indexed tree's root.
+        /// @param elem The element
+        /// @return The depth (0 for the root) or -1 if the element isn't part of the indexed tree
+        int depth(const BasicElement& elem)
+        {
+            if(!mValid)
+                build();
+            
+            auto it = mFirst.find(&elem);
+            return it == mFirst.end() ? -1 : static_cast<int>(mDepths[it->second]);
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            mValid = false;
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            mValid = false;
+        }
+    
+    private:
+        /// @brief Floor of the base-2 logarithm, from the leading zero count: value must not be 0.
+        static std::uint32_t log2(std::uint32_t value)
+        {
+            return 31 - __builtin_clz(value);
+        }
+        
+        void build()
+        {
+            mTour.clear();
+            mDepths.clear();
+            mFirst.clear();
+            mTable.clear();
+            mValid = true;
+            
+            if(!mRoot)
+                return;
+            
+            // Euler tour from the pre-order: every element is listed when entered and its parent again after it's left
+            std::vector<BasicElement*> open;
+            auto visit = [this](BasicElement* elem, std::uint32_t depth) {
+                mTour.push_back(elem);
+                mDepths.push_back(depth);
+            };
+            
+            auto range = preOrder(*mRoot);
+            for(auto it = range.begin(); it != range.end(); ++it)
+            {
+                for(; open.size() > it.depth(); open.pop_back())
+                    if(open.size() > 1)
+                        visit(open[open.size() - 2], static_cast<std::uint32_t>(open.size() - 2));
+                
+                mFirst.emplace(&*it, static_cast<std::uint32_t>(mTour.size()));
+                visit(&*it, static_cast<std::uint32_t>(it.depth()));
+                open.push_back(&*it);
+            }
+            
+            for(; open.size() > 1; open.pop_back())
+                visit(open[open.size() - 2], static_cast<std::uint32_t>(open.size() - 2));
+            
+            // Level k holds the position of the shallowest tour entry in [i, i + 2^k)
+            auto size = static_cast<std::uint32_t>(mTour.size());
+            mTable.resize(log2(size) + 1);
+            mTable[0].resize(size);
+            for(std::uint32_t i = 0; i < size; i++)
+                mTable[0][i] = i;
+            
+            for(std::uint32_t level = 1; level < mTable.size(); level++)
+            {
+                auto half = std::uint32_t(1) << (level - 1);
+                auto& prev = mTable[level - 1];
+                auto& cur = mTable[level];
+                cur.resize(size - 2 * half + 1);
+                
+                for(std::uint32_t i = 0; i < cur.size(); i++)
+                {
+                    auto left = prev[i];
+                    auto right = prev[i + half];
+                    cur[i] = mDepths[left] <= mDepths[right] ? left : right;
+                }
+            }
+        }
+        
+        BasicElement* mRoot;
+        bool mValid;
+        std::vector<BasicElement*> mTour;
+        std::vector<std::uint32_t> mDepths;
+        std::unordered_map<const BasicElement*, std::uint32_t> mFirst; // First tour position of each element
+        std::vector<std::vector<std::uint32_t>> mTable;
+    };
+}
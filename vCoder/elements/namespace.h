@@ -16,8 +16,11 @@ namespace vcoder::elements
     class Namespace : public BasicElement
     {
     public:
+        /// @brief The kind every Namespace has.
+        static constexpr ElementKind Kind = ElementKind::Namespace;
+        
         /// @brief Constructs the namespace element.
-        Namespace(const std::string& name = "") : BasicElement(name)
+        Namespace(const std::string& name = "") : BasicElement(Kind, name)
         {}
         
         /// @brief Implements BasicElement::type().
@@ -34,6 +37,22 @@ namespace vcoder::elements
             return common::CXSerializable<BasicElement::SerializationFormat, Namespace>(*this);
         }
         
+        /// @brief Implements BasicElement::specificHash().
+        /// @return The hash of this element's CX properties
+        virtual std::size_t specificHash() const override
+        {
+            return CX::Hash(*this);
+        }
+        
+        /// @brief Implements BasicElement::specificEquals().
+        /// @param other The element to compare with
+        /// @return Whether both elements are Namespaces with equal CX properties
+        virtual bool specificEquals(const BasicElement& other) const override
+        {
+            auto that = other.as<Namespace>();
+            return that && CX::Equal(*this, *that);
+        }
+        
         CXPROPS(Namespace) (
                        CXPROP(isNamespace)
                        ) CXPROPS_END;
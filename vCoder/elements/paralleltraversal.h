@@ -0,0 +1,100 @@
+//
+//  paralleltraversal.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "basicelement.h"
+#include "../common/workstealing.h"
+
+namespace vcoder::elements
+{
+    namespace detail
+    {
+        /// @brief A run of consecutive siblings.
+        struct SiblingRange
+        {
+            BasicElement* first = nullptr;
+            std::size_t count = 0;
+        };
+        
+        /// @brief The number of siblings a task visits itself before handing the rest of its range over.
+        constexpr std::size_t kParallelBlockSize = 1024;
+        
+        /// @brief Runs fn on a subtree: each task visits a block of siblings and spawns one task per child list below
+        ///        them, and the rest of its range is queued first so that wide, flat levels get spread as well.
+        template<class F>
+        void runParallel(common::WorkStealingScheduler<SiblingRange>& scheduler, BasicElement& root, const F& fn)
+        {
+            scheduler.run({ &root, 1 }, [&](const SiblingRange& range, auto& context) {
+                auto count = std::min(range.count, kParallelBlockSize);
+                if(range.count > count)
+                {
+                    auto rest = range.first;
+                    for(std::size_t i = 0; i < count; i++)
+                        rest = rest->nextSibling();
+                    context.spawn({ rest, range.count - count });
+                }
+                
+                auto elem = range.first;
+                for(std::size_t i = 0; i < count; i++, elem = elem->nextSibling())
+                {
+                    fn(*elem, context.worker());
+                    if(elem->firstChild())
+                        context.spawn({ elem->firstChild(), elem->childCount() });
+                }
+            });
+        }
+        
+        /// @brief Wraps a value so that per-worker values don't share cache lines.
+        template<class T>
+        struct alignas(64) WorkerSlot
+        {
+            T value;
+        };
+    }
+    
+    /// @brief Invokes the callback for an element and all of its descendants, spreading the work across threads.
+    /// @param root The root of the subtree to visit
+    /// @param fn The callback: must accept a BasicElement& and be safe to call concurrently
+    /// @param workers The number of threads to use: 0 to use the hardware concurrency
+    /// @remarks Subtrees and long runs of siblings are split dynamically through work stealing, so unbalanced or flat
+    ///          trees still keep every thread busy. No particular order is guaranteed and the tree must not be mutated
+    ///          meanwhile.
+    template<class F>
+    void forAllDescendantsParallel(BasicElement& root, const F& fn, std::size_t workers = 0)
+    {
+        common::WorkStealingScheduler<detail::SiblingRange> scheduler(workers);
+        detail::runParallel(scheduler, root, [&](BasicElement& elem, std::size_t) { fn(elem); });
+    }
+    
+    /// @brief Maps an element and all of its descendants to values and reduces them, spreading the work across threads.
+    /// @param root The root of the subtree to visit
+    /// @param identity The identity value of the reduction
+    /// @param map The mapping: accepts a BasicElement& and returns a T; must be safe to call concurrently
+    /// @param combine The reduction: accepts two T and returns a T; must be associative and commutative
+    /// @param workers The number of threads to use: 0 to use the hardware concurrency
+    /// @return The reduced value
+    template<class T, class Map, class Combine>
+    T reduceDescendantsParallel(BasicElement& root, const T& identity, const Map& map, const Combine& combine, std::size_t workers = 0)
+    {
+        common::WorkStealingScheduler<detail::SiblingRange> scheduler(workers);
+        std::vector<detail::WorkerSlot<T>> partials(scheduler.workerCount(), detail::WorkerSlot<T>{identity});
+        
+        // Each worker folds into its own slot: no synchronization until the final combine
+        detail::runParallel(scheduler, root, [&](BasicElement& elem, std::size_t worker) {
+            auto& partial = partials[worker].value;
+            partial = combine(partial, map(elem));
+        });
+        
+        T result = identity;
+        for(auto& partial : partials)
+            result = combine(result, partial.value);
+        return result;
+    }
+}
@@ -0,0 +1,300 @@
+//
+//  prefixindex.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+#include "traversal.h"
+#include "../common/symboltable.h"
+
+namespace vcoder::elements
+{
+    /// @brief A sorted index of interned element names for autocompletion ("every symbol starting with vco").
+    /// @remarks Names live in a sorted array searched with a binary search, plus a sorted buffer that absorbs new
+    ///          names and gets merged into the array once it holds more than about √n of them. Merges place each name
+    ///          with a binary search and only move the others, so adding a name costs O(log n) name comparisons and
+    ///          O(√n) amortized moves. Names left without elements stay in place until they make up half of the array,
+    ///          which is then compacted.
+    class PrefixIndex : public TreeObserver
+    {
+    public:
+        /// @brief Constructs the index with a symbol table of its own.
+        PrefixIndex()
+        : mOwnedSymbols(std::make_unique<common::SymbolTable>()), mSymbols(*mOwnedSymbols), mRoot(nullptr), mDead(0) {}
+        
+        /// @brief Constructs the index.
+        /// @param symbols The table names get interned in: must outlive the index
+        explicit PrefixIndex(common::SymbolTable& symbols)
+        : mSymbols(symbols), mRoot(nullptr), mDead(0) {}
+        
+        PrefixIndex(const PrefixIndex&) = delete;
+        
+        ~PrefixIndex()
+        {
+            detach();
+        }
+        
+        /// @brief Indexes a tree and starts tracking its changes.
+        /// @param root The tree's topmost element
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            
+            // Bulk load: everything goes straight to the sorted array
+            for(auto& elem : preOrder(root))
+                addHit(elem, elem.name(), mSorted);
+            std::sort(mSorted.begin(), mSorted.end(), less());
+        }
+        
+        /// @brief Stops tracking the tree and clears the index.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mHits.clear();
+            mSorted.clear();
+            mPending.clear();
+            mListed.clear();
+            mDead = 0;
+        }
+        
+        /// @brief Finds the first elements, by name, whose name starts with a prefix.
+        /// @param prefix The prefix: an empty one matches everything
+        /// @param limit The maximum number of elements to return
+        /// @param kind The kind to keep: none to keep all of them
+        /// @return The elements found, sorted by name
+        /// @remarks Costs O(log n + scanned names): names without elements of the requested kind are skipped over.
+        std::vector<BasicElement*> complete(std::string_view prefix, std::size_t limit, std::optional<ElementKind> kind = std::nullopt) const
+        {
+            std::vector<BasicElement*> result;
+            if(limit == 0)
+                return result;
+            
+            auto sorted = lowerBound(mSorted, prefix);
+            auto pending = lowerBound(mPending, prefix);
+            
+            // Walk both sorted sequences at once, like a merge
+            while(result.size() < limit)
+            {
+                auto fromSorted = sorted != mSorted.end() && startsWith(*sorted, prefix);
+                auto fromPending = pending != mPending.end() && startsWith(*pending, prefix);
+                if(!fromSorted && !fromPending)
+                    break;
+                
+                common::Symbol symbol;
+                if(fromSorted && (!fromPending || mSymbols.str(*sorted) < mSymbols.str(*pending)))
+                    symbol = *sorted++;
+                else
+                    symbol = *pending++;
+                
+                auto hits = mHits.find(symbol);
+                if(hits == mHits.end())
+                    continue;
+                
+                for(auto& hit : hits->second)
+                {
+                    if(result.size() == limit)
+                        break;
+                    if(!kind || hit.kind == *kind)
+                        result.push_back(hit.elem);
+                }
+            }
+            
+            return result;
+        }
+        
+        /// @brief Gets the number of distinct names with at least one element.
+        /// @return The number of names
+        std::size_t nameCount() const
+        {
+            return mSorted.size() + mPending.size() - mDead;
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            std::vector<common::Symbol> names;
+            for(auto& elem : preOrder(child))
+                addHit(elem, elem.name(), names);
+            list(names);
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            for(auto& elem : preOrder(child))
+                removeHit(elem, elem.name());
+        }
+        
+        virtual void onRenamed(BasicElement& element, const std::string& oldName) override
+        {
+            removeHit(element, oldName);
+            
+            std::vector<common::Symbol> names;
+            addHit(element, element.name(), names);
+            list(names);
+        }
+    
+    private:
+        struct Hit
+        {
+            BasicElement* elem;
+            ElementKind kind;
+        };
+        
+        static constexpr std::size_t kMinPendingLimit = 256;
+        
+        /// @brief Gets the number of names the buffer may hold before being merged: √n balances both merges.
+        std::size_t pendingLimit() const
+        {
+            auto balanced = static_cast<std::size_t>(std::sqrt(static_cast<double>(mSorted.size())));
+            return std::max(kMinPendingLimit, balanced);
+        }
+        
+        /// @brief Orders symbols by their names.
+        struct NameLess
+        {
+            const common::SymbolTable& symbols;
+            
+            bool operator()(common::Symbol a, common::Symbol b) const
+            {
+                return symbols.str(a) < symbols.str(b);
+            }
+        };
+        
+        NameLess less() const
+        {
+            return { mSymbols };
+        }
+        
+        bool startsWith(common::Symbol symbol, std::string_view prefix) const
+        {
+            return std::string_view(mSymbols.str(symbol)).substr(0, prefix.size()) == prefix;
+        }
+        
+        std::vector<common::Symbol>::const_iterator lowerBound(const std::vector<common::Symbol>& names, std::string_view prefix) const
+        {
+            return std::lower_bound(names.begin(), names.end(), prefix, [this](common::Symbol symbol, std::string_view prefix) {
+                return std::string_view(mSymbols.str(symbol)) < prefix;
+            });
+        }
+        
+        /// @brief Records an element under its name.
+        /// @param names Receives the name if it isn't listed yet: it has to be listed by the caller
+        void addHit(BasicElement& elem, const std::string& name, std::vector<common::Symbol>& names)
+        {
+            auto symbol = mSymbols.intern(name);
+            auto& hits = mHits[symbol];
+            hits.push_back({ &elem, elem.kind() });
+            
+            if(symbol >= mListed.size())
+                mListed.resize(mSymbols.size(), false);
+            
+            if(mListed[symbol])
+            {
+                // A name that had lost all of its elements is back in use
+                if(hits.size() == 1)
+                    mDead--;
+                return;
+            }
+            
+            mListed[symbol] = true;
+            names.push_back(symbol);
+        }
+        
+        /// @brief Lists new names: they're sorted and merged into the buffer, which is merged into the array once it
+        ///        grows too large. Done once per change, so that adding a large subtree costs O(k log n).
+        void list(std::vector<common::Symbol>& names)
+        {
+            if(names.empty())
+                return;
+            
+            std::sort(names.begin(), names.end(), less());
+            merge(mPending, names);
+            
+            if(mPending.size() > pendingLimit())
+            {
+                merge(mSorted, mPending);
+                mPending.clear();
+            }
+        }
+        
+        /// @brief Merges sorted names into a sorted array with O(k log n) name comparisons: each name is placed with a
+        ///        binary search, and the names in between are moved in bulk, from the back.
+        void merge(std::vector<common::Symbol>& into, const std::vector<common::Symbol>& names) const
+        {
+            auto last = into.size();
+            into.resize(last + names.size());
+            
+            auto out = into.end();
+            auto end = into.begin() + static_cast<std::ptrdiff_t>(last);
+            for(auto name = names.rbegin(); name != names.rend(); ++name)
+            {
+                auto at = std::upper_bound(into.begin(), end, *name, less());
+                out = std::move_backward(at, end, out);
+                *--out = *name;
+                end = at;
+            }
+        }
+        
+        void removeHit(BasicElement& elem, const std::string& name)
+        {
+            common::Symbol symbol;
+            if(!mSymbols.find(name, symbol))
+                return;
+            
+            auto hits = mHits.find(symbol);
+            if(hits == mHits.end())
+                return;
+            
+            auto& list = hits->second;
+            auto it = std::find_if(list.begin(), list.end(), [&elem](const Hit& hit) { return hit.elem == &elem; });
+            if(it == list.end())
+                return;
+            
+            list.erase(it);
+            if(list.empty() && ++mDead > (mSorted.size() + mPending.size()) / 2)
+                compact();
+        }
+        
+        void compact()
+        {
+            auto dead = [this](common::Symbol symbol) {
+                auto hits = mHits.find(symbol);
+                if(hits != mHits.end() && !hits->second.empty())
+                    return false;
+                
+                mHits.erase(symbol);
+                mListed[symbol] = false;
+                return true;
+            };
+            
+            mSorted.erase(std::remove_if(mSorted.begin(), mSorted.end(), dead), mSorted.end());
+            mPending.erase(std::remove_if(mPending.begin(), mPending.end(), dead), mPending.end());
+            mDead = 0;
+        }
+        
+        std::unique_ptr<common::SymbolTable> mOwnedSymbols; // Unless given a table
+        common::SymbolTable& mSymbols;
+        BasicElement* mRoot;
+        std::unordered_map<common::Symbol, std::vector<Hit>> mHits;
+        std::vector<common::Symbol> mSorted;
+        std::vector<common::Symbol> mPending; // Recently added names, kept sorted
+        std::vector<bool> mListed;            // Whether a symbol is in mSorted or mPending
+        std::size_t mDead;                    // Listed names without any elements
+    };
+}
@@ -0,0 +1,167 @@
+//
+//  qualifiednameindex.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+#include "traversal.h"
+
+namespace vcoder::elements
+{
+    /// @brief A hash index from fully qualified names (vcoder::Run) to elements, kept up to date as the tree changes.
+    /// @remarks Several elements may share a qualified name (e.g. overloads). Attach the index after a bulk load:
+    ///          it's then built in a single pass instead of through one update per insertion.
+    class QualifiedNameIndex : public TreeObserver
+    {
+    public:
+        QualifiedNameIndex()
+        : mRoot(nullptr) {}
+        
+        QualifiedNameIndex(const QualifiedNameIndex&) = delete;
+        
+        ~QualifiedNameIndex()
+        {
+            detach();
+        }
+        
+        /// @brief Indexes a tree and starts tracking its changes.
+        /// @param root The tree's topmost element: the global scope
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            
+            // The root is the global scope and has no qualified name of its own
+            for(auto child = root.firstChild(); child; child = child->nextSibling())
+                indexSubtree(*child, "");
+        }
+        
+        /// @brief Stops tracking the tree and clears the index.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mIndex.clear();
+        }
+        
+        /// @brief Looks up an element by its qualified name in O(1) on average.
+        /// @param name The qualified name, e.g. vcoder::Run
+        /// @return The first element found with that name or nullptr
+        BasicElement* find(const std::string& name) const
+        {
+            auto it = mIndex.find(name);
+            return it == mIndex.end() ? nullptr : it->second;
+        }
+        
+        /// @brief Looks up all elements sharing a qualified name.
+        /// @param name The qualified name, e.g. vcoder::Run
+        /// @return The elements found
+        std::vector<BasicElement*> findAll(const std::string& name) const
+        {
+            std::vector<BasicElement*> result;
+            auto range = mIndex.equal_range(name);
+            for(auto it = range.first; it != range.second; ++it)
+                result.push_back(it->second);
+            return result;
+        }
+        
+        /// @brief Gets the number of indexed elements.
+        /// @return The number of elements: every element of the tree except its root
+        std::size_t size() const
+        {
+            return mIndex.size();
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            indexSubtree(child, prefixOf(parent));
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            unindexSubtree(child, prefixOf(parent) + child.name());
+        }
+        
+        virtual void onRenamed(BasicElement& element, const std::string& oldName) override
+        {
+            if(&element == mRoot || !element.parent())
+                return;
+            
+            auto prefix = prefixOf(*element.parent());
+            unindexSubtree(element, prefix + oldName);
+            indexSubtree(element, prefix);
+        }
+    
+    private:
+        /// @brief Gets the qualified name prefix for the children of an element: "" for the root, "a::b::" otherwise.
+        std::string prefixOf(const BasicElement& elem) const
+        {
+            auto name = elem.qualifiedName();
+            return name.empty() ? name : name + "::";
+        }
+        
+        /// @brief Walks a subtree once, building qualified names incrementally in a single buffer.
+        /// @param top The subtree's root
+        /// @param topName The subtree root's qualified name
+        /// @param fn Called as fn(qualifiedName, element)
+        template<class F>
+        static void forEachQualified(BasicElement& top, const std::string& topName, const F& fn)
+        {
+            std::string name;
+            std::vector<std::size_t> lengths; // Length of each ancestor's qualified name, by depth
+            
+            auto range = preOrder(top);
+            for(auto it = range.begin(); it != range.end(); ++it)
+            {
+                auto depth = it.depth();
+                if(depth == 0)
+                    name = topName;
+                else
+                {
+                    name.resize(lengths[depth - 1]);
+                    name += "::";
+                    name += it->name();
+                }
+                
+                lengths.resize(depth + 1);
+                lengths[depth] = name.size();
+                fn(name, *it);
+            }
+        }
+        
+        void indexSubtree(BasicElement& top, const std::string& prefix)
+        {
+            forEachQualified(top, prefix + top.name(), [this](const std::string& name, BasicElement& elem) {
+                mIndex.emplace(name, &elem);
+            });
+        }
+        
+        void unindexSubtree(BasicElement& top, const std::string& topName)
+        {
+            forEachQualified(top, topName, [this](const std::string& name, BasicElement& elem) {
+                auto range = mIndex.equal_range(name);
+                for(auto it = range.first; it != range.second; ++it)
+                {
+                    if(it->second == &elem)
+                    {
+                        mIndex.erase(it);
+                        break;
+                    }
+                }
+            });
+        }
+        
+        BasicElement* mRoot;
+        std::unordered_multimap<std::string, BasicElement*> mIndex;
+    };
+}
@@ -0,0 +1,342 @@
+//
+//  referencegraph.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "handletable.h"
+
+namespace vcoder::elements
+{
+    /// @brief "Uses" edges between elements, e.g. from a function to the types it uses, keyed by element handles.
+    /// @remarks Edges are stored twice in compressed sparse row form, by user and by used element: each row is a sorted
+    ///          slice of one array, so listing the uses or users of an element is a contiguous scan. Edits go to delta
+    ///          buffers instead (added edges per row and removed ones as tombstones), which queries consult on the side,
+    ///          and the buffers are merged back into the rows once they grow past an eighth of the graph.
+    ///          An edge is either there or not: adding it twice keeps one.
+    class ReferenceGraph
+    {
+    public:
+        struct Edge
+        {
+            Handle from; // The user
+            Handle to;   // The element used
+        };
+        
+        ReferenceGraph()
+        : mDeltaCount(0), mWorkers(0) {}
+        
+        /// @brief Replaces every edge, building the rows from scratch.
+        /// @param edges The edges: duplicates are dropped
+        /// @param workers The number of threads to build with: 0 to use the hardware concurrency
+        void build(const std::vector<Edge>& edges, std::size_t workers = 0)
+        {
+            mWorkers = workers;
+            clearDeltas();
+            
+            Handle bound = 0;
+            for(auto& edge : edges)
+                bound = std::max(bound, Handle(std::max(edge.from, edge.to) + 1));
+            
+            buildRows(mUses, edges, bound, false);
+            buildRows(mUsers, edges, bound, true);
+        }
+        
+        /// @brief Adds an edge.
+        /// @param from The user
+        /// @param to The element used
+        /// @return Whether the edge is new
+        bool addEdge(Handle from, Handle to)
+        {
+            if(hasEdge(from, to))
+                return false;
+            
+            // Bringing back an edge the rows still hold only takes dropping its tombstone
+            if(mRemoved.erase(key(from, to)))
+                mDeltaCount--;
+            else
+            {
+                mAddedUses[from].push_back(to);
+                mAddedUsers[to].push_back(from);
+                noteDelta();
+            }
+            return true;
+        }
+        
+        /// @brief Removes an edge.
+        /// @param from The user
+        /// @param to The element used
+        /// @return Whether there was such an edge
+        bool removeEdge(Handle from, Handle to)
+        {
+            if(eraseAdded(mAddedUses, from, to))
+            {
+                eraseAdded(mAddedUsers, to, from);
+                mDeltaCount--;
+            }
+            else if(rowHas(mUses, from, to) && mRemoved.insert(key(from, to)).second)
+                noteDelta();
+            else
+                return false;
+            
+            return true;
+        }
+        
+        /// @brief Removes every edge from or to an element, e.g. before releasing its handle.
+        /// @param handle The element's handle
+        void removeElement(Handle handle)
+        {
+            for(auto to : uses(handle))
+                removeEdge(handle, to);
+            for(auto from : users(handle))
+                removeEdge(from, handle);
+        }
+        
+        /// @brief Checks whether an edge exists.
+        /// @param from The user
+        /// @param to The element used
+        /// @return Whether it does
+        bool hasEdge(Handle from, Handle to) const
+        {
+            if(rowHas(mUses, from, to))
+                return mRemoved.empty() || !mRemoved.count(key(from, to));
+            
+            auto added = mAddedUses.find(from);
+            return added != mAddedUses.end() && std::find(added->second.begin(), added->second.end(), to) != added->second.end();
+        }
+        
+        /// @brief Invokes the callback for every element an element uses.
+        /// @param from The user's handle
+        /// @param fn The callback: must accept one argument of type Handle
+        template<class F>
+        void forEachUse(Handle from, const F& fn) const
+        {
+            forEachInRow(mUses, mAddedUses, from, false, fn);
+        }
+        
+        /// @brief Invokes the callback for every element using an element.
+        /// @param to The used element's handle
+        /// @param fn The callback: must accept one argument of type Handle
+        template<class F>
+        void forEachUser(Handle to, const F& fn) const
+        {
+            forEachInRow(mUsers, mAddedUsers, to, true, fn);
+        }
+        
+        /// @brief Collects the elements an element uses.
+        /// @param from The user's handle
+        /// @return The handles of the elements used
+        std::vector<Handle> uses(Handle from) const
+        {
+            std::vector<Handle> result;
+            forEachUse(from, [&result](Handle to) { result.push_back(to); });
+            return result;
+        }
+        
+        /// @brief Collects the elements using an element.
+        /// @param to The used element's handle
+        /// @return The handles of the users
+        std::vector<Handle> users(Handle to) const
+        {
+            std::vector<Handle> result;
+            forEachUser(to, [&result](Handle from) { result.push_back(from); });
+            return result;
+        }
+        
+        /// @brief Gets the number of edges.
+        /// @return The edge count
+        std::size_t edgeCount() const
+        {
+            std::size_t added = 0;
+            for(auto& row : mAddedUses)
+                added += row.second.size();
+            return mUses.targets.size() - mRemoved.size() + added;
+        }
+        
+        /// @brief Merges the delta buffers into the rows: done automatically as they grow.
+        void merge()
+        {
+            if(!mDeltaCount)
+                return;
+            
+            std::vector<Edge> edges;
+            edges.reserve(edgeCount());
+            for(Handle from = 0; from + 1 < mUses.offsets.size(); from++)
+                forEachUse(from, [&edges, from](Handle to) { edges.push_back({ from, to }); });
+            for(auto& row : mAddedUses)
+                if(row.first + 1 >= mUses.offsets.size())
+                    for(auto to : row.second)
+                        edges.push_back({ row.first, to });
+            
+            build(edges, mWorkers);
+        }
+        
+        /// @brief Gets the number of edits waiting in the delta buffers.
+        /// @return The edit count
+        std::size_t deltaCount() const
+        {
+            return mDeltaCount;
+        }
+    
+    private:
+        static constexpr std::size_t kMinMerge = 1024;  // Deltas always tolerated before merging
+        static constexpr std::size_t kMinChunk = 16384; // Edges or rows per thread: fewer aren't worth a thread
+        
+        /// @brief One direction of the graph: the row of handle h is targets[offsets[h], offsets[h + 1]).
+        struct Rows
+        {
+            std::vector<std::uint32_t> offsets;
+            std::vector<Handle> targets;
+        };
+        
+        static std::uint64_t key(Handle from, Handle to)
+        {
+            return (std::uint64_t(from) << 32) | to;
+        }
+        
+        static bool rowHas(const Rows& rows, Handle handle, Handle target)
+        {
+            if(std::size_t(handle) + 1 >= rows.offsets.size())
+                return false;
+            
+            auto first = rows.targets.begin() + rows.offsets[handle];
+            auto last = rows.targets.begin() + rows.offsets[handle + 1];
+            return std::binary_search(first, last, target);
+        }
+        
+        static bool eraseAdded(std::unordered_map<Handle, std::vector<Handle>>& added, Handle handle, Handle target)
+        {
+            auto row = added.find(handle);
+            if(row == added.end())
+                return false;
+            
+            auto found = std::find(row->second.begin(), row->second.end(), target);
+            if(found == row->second.end())
+                return false;
+            
+            *found = row->second.back();
+            row->second.pop_back();
+            if(row->second.empty())
+                added.erase(row);
+            return true;
+        }
+        
+        template<class F>
+        void forEachInRow(const Rows& rows, const std::unordered_map<Handle, std::vector<Handle>>& added, Handle handle, bool reversed, const F& fn) const
+        {
+            if(std::size_t(handle) + 1 < rows.offsets.size())
+            {
+                for(auto i = rows.offsets[handle]; i < rows.offsets[handle + 1]; i++)
+                {
+                    auto target = rows.targets[i];
+                    if(mRemoved.empty() || !mRemoved.count(reversed ? key(target, handle) : key(handle, target)))
+                        fn(target);
+                }
+            }
+            
+            auto row = added.find(handle);
+            if(row != added.end())
+                for(auto target : row->second)
+                    fn(target);
+        }
+        
+        /// @brief Runs fn(first, last) over slices of [0, count) on up to the configured number of threads.
+        template<class F>
+        void parallelFor(std::size_t count, const F& fn) const
+        {
+            auto workers = mWorkers ? mWorkers : std::max(1u, std::thread::hardware_concurrency());
+            workers = std::max<std::size_t>(1, std::min(workers, count / kMinChunk));
+            
+            auto slice = [&](std::size_t worker) {
+                fn(count * worker / workers, count * (worker + 1) / workers);
+            };
+            
+            std::vector<std::thread> threads;
+            for(std::size_t i = 1; i < workers; i++)
+                threads.emplace_back(slice, i);
+            slice(0);
+            for(auto& thread : threads)
+                thread.join();
+        }
+        
+        /// @brief Builds one direction: counts the degrees, scatters the edges into their rows, then sorts and
+        ///        deduplicates each row. Every pass is split across threads.
+        void buildRows(Rows& rows, const std::vector<Edge>& edges, Handle bound, bool reversed)
+        {
+            auto source = [reversed](const Edge& edge) { return reversed ? edge.to : edge.from; };
+            auto target = [reversed](const Edge& edge) { return reversed ? edge.from : edge.to; };
+            
+            std::vector<std::atomic<std::uint32_t>> cursors(bound);
+            parallelFor(edges.size(), [&](std::size_t first, std::size_t last) {
+                for(auto i = first; i < last; i++)
+                    cursors[source(edges[i])].fetch_add(1, std::memory_order_relaxed);
+            });
+            
+            std::vector<std::uint32_t> offsets(std::size_t(bound) + 1);
+            for(Handle h = 0; h < bound; h++)
+            {
+                offsets[h + 1] = offsets[h] + cursors[h].load(std::memory_order_relaxed);
+                cursors[h].store(offsets[h], std::memory_order_relaxed);
+            }
+            
+            std::vector<Handle> targets(edges.size());
+            parallelFor(edges.size(), [&](std::size_t first, std::size_t last) {
+                for(auto i = first; i < last; i++)
+                    targets[cursors[source(edges[i])].fetch_add(1, std::memory_order_relaxed)] = target(edges[i]);
+            });
+            
+            // Rows are sorted for binary searches and deduplicated in place: sizes are collected to compact them next
+            std::vector<std::uint32_t> sizes(bound);
+            parallelFor(bound, [&](std::size_t first, std::size_t last) {
+                for(auto h = first; h < last; h++)
+                {
+                    auto begin = targets.begin() + offsets[h];
+                    std::sort(begin, targets.begin() + offsets[h + 1]);
+                    sizes[h] = std::uint32_t(std::unique(begin, targets.begin() + offsets[h + 1]) - begin);
+                }
+            });
+            
+            rows.offsets.assign(std::size_t(bound) + 1, 0);
+            for(Handle h = 0; h < bound; h++)
+                rows.offsets[h + 1] = rows.offsets[h] + sizes[h];
+            
+            rows.targets.resize(rows.offsets[bound]);
+            parallelFor(bound, [&](std::size_t first, std::size_t last) {
+                for(auto h = first; h < last; h++)
+                    std::copy_n(targets.begin() + offsets[h], sizes[h], rows.targets.begin() + rows.offsets[h]);
+            });
+        }
+        
+        void clearDeltas()
+        {
+            mAddedUses.clear();
+            mAddedUsers.clear();
+            mRemoved.clear();
+            mDeltaCount = 0;
+        }
+        
+        void noteDelta()
+        {
+            if(++mDeltaCount > std::max(kMinMerge, mUses.targets.size() / 8))
+                merge();
+        }
+        
+        Rows mUses;
+        Rows mUsers;
+        std::unordered_map<Handle, std::vector<Handle>> mAddedUses;  // Edges added since the last build, by user
+        std::unordered_map<Handle, std::vector<Handle>> mAddedUsers; // The same edges by used element
+        std::unordered_set<std::uint64_t> mRemoved;                  // Tombstones of removed edges still in the rows
+        std::size_t mDeltaCount;
+        std::size_t mWorkers;
+    };
+}
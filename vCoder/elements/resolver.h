@@ -0,0 +1,244 @@
+//
+//  resolver.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "basicelement.h"
+#include "../common/symboltable.h"
+
+namespace vcoder::elements
+{
+    /// @brief Resolves unqualified names the way scopes nest: in the scope itself, then in each enclosing one up to the
+    ///        root, with every answer memoized.
+    /// @remarks Lookups go through the per-scope child indexes of BasicElement::findChild(). Answers are memoized per
+    ///          (scope, name), for every scope a lookup passes through: a scope that doesn't declare the name defers to
+    ///          its parent's answer, so resolving every reference of a model costs O(distinct scope and name pairs).
+    ///          Edits invalidate eagerly and only what they affect: declaring, removing or renaming a child drops the
+    ///          answers for that name in its parent and in the scopes deferring to them; moving a subtree drops the
+    ///          answers of the scopes inside it, in O(subtree).
+    class ScopeResolver : public TreeObserver
+    {
+    public:
+        /// @brief Constructs the resolver with a symbol table of its own.
+        ScopeResolver()
+        : mOwnedSymbols(std::make_unique<common::SymbolTable>()), mSymbols(*mOwnedSymbols), mRoot(nullptr) {}
+        
+        /// @brief Constructs the resolver.
+        /// @param symbols The table names get interned in: must outlive the resolver
+        explicit ScopeResolver(common::SymbolTable& symbols)
+        : mSymbols(symbols), mRoot(nullptr) {}
+        
+        ScopeResolver(const ScopeResolver&) = delete;
+        
+        ~ScopeResolver()
+        {
+            detach();
+        }
+        
+        /// @brief Starts tracking a tree's changes: lookups may only be made in that tree.
+        /// @param root The tree's topmost element
+        void attach(BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+        }
+        
+        /// @brief Stops tracking the tree and clears the memo.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mRoot = nullptr;
+            mMemo.clear();
+            mByScope.clear();
+        }
+        
+        /// @brief Resolves a name as seen from a scope.
+        /// @param scope The element the name is used in
+        /// @param name The name: with "::" separators, the first part is looked up through the enclosing scopes and
+        ///        the rest below it
+        /// @return The element found or nullptr
+        BasicElement* resolve(BasicElement& scope, std::string_view name)
+        {
+            auto separator = name.find("::");
+            auto head = name.substr(0, separator);
+            auto found = lookup(scope, mSymbols.intern(head), head);
+            
+            if(!found || separator == name.npos)
+                return found;
+            return found->resolve(name.substr(separator + 2));
+        }
+        
+        /// @brief Gets the number of memoized answers.
+        /// @return The answer count
+        std::size_t memoSize() const
+        {
+            return mMemo.size();
+        }
+        
+        virtual void onChildAdded(BasicElement& parent, BasicElement& child) override
+        {
+            invalidate(parent, child.name());
+        }
+        
+        virtual void onChildRemoving(BasicElement& parent, BasicElement& child) override
+        {
+            invalidate(parent, child.name());
+            if(!mByScope.empty())
+                forget(child);
+        }
+        
+        virtual void onRenamed(BasicElement& element, const std::string& oldName) override
+        {
+            if(auto parent = element.parent())
+            {
+                invalidate(*parent, oldName);
+                invalidate(*parent, element.name());
+            }
+        }
+    
+    private:
+        struct Key
+        {
+            const BasicElement* scope;
+            common::Symbol name;
+            
+            bool operator==(const Key& other) const
+            {
+                return scope == other.scope && name == other.name;
+            }
+        };
+        
+        struct KeyHash
+        {
+            std::size_t operator()(const Key& key) const
+            {
+                return std::hash<const void*>()(key.scope) ^ (std::size_t(key.name) * 0x9E3779B97F4A7C15ull);
+            }
+        };
+        
+        struct Answer
+        {
+            BasicElement* element = nullptr;          // The element found or nullptr
+            const BasicElement* deferredTo = nullptr; // The scope whose answer this one defers to, if any
+            std::vector<BasicElement*> dependents;    // The child scopes deferring to this answer
+        };
+        
+        BasicElement* lookup(BasicElement& scope, common::Symbol symbol, std::string_view name)
+        {
+            // Walk up until a memoized answer or a declaration, remembering the scopes to memoize on the way back
+            std::vector<BasicElement*> path;
+            BasicElement* found = nullptr;
+            BasicElement* answered = nullptr; // The scope whose memoized answer ended the walk
+            for(auto current = &scope; current; current = current->parent())
+            {
+                auto memo = mMemo.find({ current, symbol });
+                if(memo != mMemo.end())
+                {
+                    found = memo->second.element;
+                    answered = current;
+                    break;
+                }
+                
+                path.push_back(current);
+                if((found = current->findChild(name)))
+                    break;
+            }
+            
+            // The last scope walked answers by itself unless the walk ended on a memoized answer; the others defer
+            for(auto i = path.size(); i-- > 0;)
+            {
+                auto deferredTo = i + 1 < path.size() ? path[i + 1] : answered;
+                auto& answer = mMemo[{ path[i], symbol }];
+                answer.element = found;
+                answer.deferredTo = deferredTo;
+                mByScope[path[i]].push_back(symbol);
+                
+                if(deferredTo)
+                    mMemo[{ deferredTo, symbol }].dependents.push_back(path[i]);
+            }
+            
+            return found;
+        }
+        
+        /// @brief Drops the answers for a name in a scope and, transitively, in the scopes deferring to them.
+        void invalidate(BasicElement& scope, std::string_view name)
+        {
+            common::Symbol symbol;
+            if(mMemo.empty() || !mSymbols.find(name, symbol))
+                return;
+            
+            std::vector<const BasicElement*> pending { &scope };
+            while(!pending.empty())
+            {
+                auto current = pending.back();
+                pending.pop_back();
+                
+                auto memo = mMemo.find({ current, symbol });
+                if(memo == mMemo.end())
+                    continue;
+                
+                pending.insert(pending.end(), memo->second.dependents.begin(), memo->second.dependents.end());
+                erase(memo, symbol);
+                
+                auto& symbols = mByScope[current];
+                symbols.erase(std::find(symbols.begin(), symbols.end(), symbol));
+                if(symbols.empty())
+                    mByScope.erase(current);
+            }
+        }
+        
+        /// @brief Drops an answer, taking its scope off the dependents of the answer it deferred to.
+        void erase(std::unordered_map<Key, Answer, KeyHash>::iterator memo, common::Symbol symbol)
+        {
+            if(memo->second.deferredTo)
+            {
+                auto deferredTo = mMemo.find({ memo->second.deferredTo, symbol });
+                if(deferredTo != mMemo.end())
+                {
+                    auto& dependents = deferredTo->second.dependents;
+                    auto found = std::find(dependents.begin(), dependents.end(), memo->first.scope);
+                    if(found != dependents.end())
+                    {
+                        *found = dependents.back();
+                        dependents.pop_back();
+                    }
+                }
+            }
+            mMemo.erase(memo);
+        }
+        
+        /// @brief Drops every answer of the scopes in a subtree: it leaves the scopes they were looked up through.
+        void forget(BasicElement& elem)
+        {
+            auto symbols = mByScope.find(&elem);
+            if(symbols != mByScope.end())
+            {
+                for(auto symbol : symbols->second)
+                    erase(mMemo.find({ &elem, symbol }), symbol);
+                mByScope.erase(symbols);
+            }
+            
+            elem.forAllChildren([this](BasicElement& child) { forget(child); });
+        }
+        
+        std::unique_ptr<common::SymbolTable> mOwnedSymbols; // Unless given a table
+        common::SymbolTable& mSymbols;
+        BasicElement* mRoot;
+        std::unordered_map<Key, Answer, KeyHash> mMemo;
+        std::unordered_map<const BasicElement*, std::vector<common::Symbol>> mByScope; // The memoized names per scope
+    };
+}
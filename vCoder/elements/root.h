@@ -15,8 +15,11 @@ namespace vcoder::elements
     class Root : public BasicElement
     {
     public:
+        /// @brief The kind every Root has.
+        static constexpr ElementKind Kind = ElementKind::Root;
+        
         /// @brief Constructs the root element, internally named _ROOT.
-        Root() : BasicElement("_ROOT")
+        Root() : BasicElement(Kind, "_ROOT")
         {}
         
         /// @brief Implements BasicElement::getSerializable().
@@ -33,6 +36,22 @@ namespace vcoder::elements
             return "Root";
         }
         
+        /// @brief Implements BasicElement::specificHash().
+        /// @return The hash of this element's CX properties
+        virtual std::size_t specificHash() const override
+        {
+            return CX::Hash(*this);
+        }
+        
+        /// @brief Implements BasicElement::specificEquals().
+        /// @param other The element to compare with
+        /// @return Whether both elements are Roots with equal CX properties
+        virtual bool specificEquals(const BasicElement& other) const override
+        {
+            auto that = other.as<Root>();
+            return that && CX::Equal(*this, *that);
+        }
+        
         CXPROPS(Root) (
                         CXPROP(isRoot)
         ) CXPROPS_END;
@@ -0,0 +1,289 @@
+//
+//  selector.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "basicelement.h"
+#include "kindindex.h"
+#include "../common/workstealing.h"
+
+namespace vcoder::elements
+{
+    /// @brief A compiled path query over element trees, e.g. vcoder/**/[Function] or */UInt32[Type].
+    /// @remarks A selector is a '/'-separated list of steps, each matching one level below the query root:
+    ///          - name matches children with that name: '*' and '?' work as in file globs;
+    ///          - name[Kind] also requires the kind, named as BasicElement::type() does: [Kind] alone accepts any name;
+    ///          - ** matches any number of levels, zero included.
+    ///          It's compiled into an automaton whose states are the steps, so a tree is matched in a single pass carrying
+    ///          the set of active states down as a bitmask. Subtrees where the set becomes empty are skipped; when every
+    ///          active step is a plain name, only the children with those names are visited through the child index.
+    class Selector
+    {
+    public:
+        /// @brief Compiles a selector.
+        /// @param text The selector's text
+        /// @remarks Throws std::runtime_error if the text is malformed, names an unknown kind or has more than 63 steps.
+        explicit Selector(std::string_view text)
+        {
+            while(!text.empty())
+            {
+                auto separator = text.find('/');
+                parseStep(text.substr(0, separator));
+                text = separator == text.npos ? std::string_view() : text.substr(separator + 1);
+            }
+            
+            if(mSteps.empty())
+                throw std::runtime_error("Empty selector");
+            if(mSteps.size() >= 64)
+                throw std::runtime_error("Too many selector steps");
+        }
+        
+        /// @brief Invokes the callback for every element below the root matching the selector, in pre-order.
+        /// @param root The element to query from: it's never matched itself
+        /// @param fn The callback: must accept one argument of type BasicElement&
+        /// @param kinds An optional kind index of the tree: "**/[Kind]" tails are answered from it instead of walking,
+        ///        which needs an IntervalLabeler attached to the tree too and gives up the pre-order guarantee
+        template<class F>
+        void forEachMatch(BasicElement& root, const F& fn, KindIndex* kinds = nullptr) const
+        {
+            visit(root, closure(1), fn, kinds);
+        }
+        
+        /// @brief Collects every element below the root matching the selector.
+        /// @param root The element to query from: it's never matched itself
+        /// @param kinds An optional kind index of the tree, see forEachMatch()
+        /// @return The elements found
+        std::vector<BasicElement*> select(BasicElement& root, KindIndex* kinds = nullptr) const
+        {
+            std::vector<BasicElement*> result;
+            forEachMatch(root, [&result](BasicElement& elem) { result.push_back(&elem); }, kinds);
+            return result;
+        }
+        
+        /// @brief Invokes the callback for every element below the root matching the selector, spreading sibling
+        ///        subtrees across threads.
+        /// @param root The element to query from: it's never matched itself
+        /// @param fn The callback: must accept a BasicElement& and be safe to call concurrently
+        /// @param workers The number of threads to use: 0 to use the hardware concurrency
+        /// @remarks No particular order is guaranteed and the tree must not be mutated meanwhile.
+        template<class F>
+        void forEachMatchParallel(BasicElement& root, const F& fn, std::size_t workers = 0) const
+        {
+            common::WorkStealingScheduler<Task> scheduler(workers);
+            scheduler.run({ &root, closure(1) }, [&](const Task& task, auto& context) {
+                forEachCandidate(*task.elem, task.states, [&](BasicElement& child, StateSet next) {
+                    if(next & accepting())
+                        fn(child);
+                    if(child.firstChild())
+                        context.spawn({ &child, next });
+                });
+            });
+        }
+    
+    private:
+        using StateSet = std::uint64_t; // Bit i: step i is expected next; bit mSteps.size(): matched
+        
+        struct Step
+        {
+            std::string name;  // Empty to accept any name
+            ElementKind kind = ElementKind::Root;
+            bool anyKind = true;
+            bool anyDepth = false;
+            bool glob = false; // Whether the name has wildcards
+        };
+        
+        struct Task
+        {
+            BasicElement* elem = nullptr;
+            StateSet states = 0;
+        };
+        
+        void parseStep(std::string_view text)
+        {
+            Step step;
+            if(text == "**")
+                step.anyDepth = true;
+            else
+            {
+                auto bracket = text.find('[');
+                if(bracket != text.npos)
+                {
+                    if(text.back() != ']' || !parseElementKind(text.substr(bracket + 1, text.size() - bracket - 2), step.kind))
+                        throw std::runtime_error("Malformed kind in selector step: " + std::string(text));
+                    
+                    step.anyKind = false;
+                    text = text.substr(0, bracket);
+                }
+                
+                if(text.empty() && step.anyKind)
+                    throw std::runtime_error("Empty selector step");
+                
+                // A lone '*' accepts anything, so there's nothing to compare
+                if(text != "*")
+                    step.name = text;
+                step.glob = step.name.find_first_of("*?") != std::string::npos;
+            }
+            
+            mSteps.push_back(std::move(step));
+        }
+        
+        StateSet accepting() const
+        {
+            return StateSet(1) << mSteps.size();
+        }
+        
+        /// @brief Adds the states reachable without consuming a level: ** may match zero of them.
+        StateSet closure(StateSet states) const
+        {
+            for(std::size_t i = 0; i < mSteps.size(); i++)
+                if((states & (StateSet(1) << i)) && mSteps[i].anyDepth)
+                    states |= StateSet(1) << (i + 1);
+            return states;
+        }
+        
+        static bool globMatch(std::string_view pattern, std::string_view str)
+        {
+            // Iterative glob with single-star backtracking
+            std::size_t p = 0, s = 0, star = std::string_view::npos, mark = 0;
+            while(s < str.size())
+            {
+                if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s]))
+                {
+                    p++;
+                    s++;
+                }
+                else if(p < pattern.size() && pattern[p] == '*')
+                {
+                    star = p++;
+                    mark = s;
+                }
+                else if(star != std::string_view::npos)
+                {
+                    p = star + 1;
+                    s = ++mark;
+                }
+                else
+                    return false;
+            }
+            
+            while(p < pattern.size() && pattern[p] == '*')
+                p++;
+            return p == pattern.size();
+        }
+        
+        bool matches(const Step& step, const BasicElement& elem) const
+        {
+            if(!step.anyKind && elem.kind() != step.kind)
+                return false;
+            if(step.name.empty())
+                return true;
+            
+            auto name = elem.name();
+            return step.glob ? globMatch(step.name, name) : name == step.name;
+        }
+        
+        /// @brief Moves the automaton down one level, into the given element.
+        StateSet advance(StateSet states, const BasicElement& elem) const
+        {
+            StateSet next = 0;
+            for(std::size_t i = 0; i < mSteps.size(); i++)
+            {
+                if(!(states & (StateSet(1) << i)))
+                    continue;
+                
+                if(mSteps[i].anyDepth)
+                    next |= StateSet(1) << i;
+                else if(matches(mSteps[i], elem))
+                    next |= StateSet(1) << (i + 1);
+            }
+            return closure(next);
+        }
+        
+        /// @brief Invokes fn(child, states) for the children of an element that keep the automaton alive.
+        template<class F>
+        void forEachCandidate(BasicElement& parent, StateSet states, const F& fn) const
+        {
+            if(!(states & (accepting() - 1)))
+                return;
+            
+            auto consider = [&](BasicElement& child) {
+                auto next = advance(states, child);
+                if(next)
+                    fn(child, next);
+            };
+            
+            // When every active step wants a plain name, only children with one of those names can go anywhere
+            std::vector<const std::string*> names;
+            for(std::size_t i = 0; i < mSteps.size(); i++)
+            {
+                if(!(states & (StateSet(1) << i)))
+                    continue;
+                
+                auto& step = mSteps[i];
+                if(step.anyDepth || step.glob || step.name.empty())
+                {
+                    names.clear();
+                    break;
+                }
+                
+                if(std::find_if(names.begin(), names.end(), [&step](const std::string* name) { return *name == step.name; }) == names.end())
+                    names.push_back(&step.name);
+            }
+            
+            if(names.empty())
+            {
+                parent.forAllChildren(consider);
+                return;
+            }
+            
+            for(auto name : names)
+                parent.forEachChildNamed(*name, consider);
+        }
+        
+        /// @brief Checks whether the active states are exactly "**/[Kind]" at the end of the selector.
+        /// @return The kind or nullptr
+        const ElementKind* kindTail(StateSet states) const
+        {
+            auto count = mSteps.size();
+            if(count < 2 || !mSteps[count - 2].anyDepth || !mSteps[count - 1].name.empty() || mSteps[count - 1].anyKind)
+                return nullptr;
+            
+            auto tail = (StateSet(1) << (count - 2)) | (StateSet(1) << (count - 1));
+            return states == tail ? &mSteps[count - 1].kind : nullptr;
+        }
+        
+        template<class F>
+        void visit(BasicElement& parent, StateSet states, const F& fn, KindIndex* kinds) const
+        {
+            if(kinds)
+            {
+                if(auto kind = kindTail(states))
+                {
+                    kinds->forEachIn(*kind, parent, [&parent, &fn](BasicElement& elem) {
+                        if(&elem != &parent)
+                            fn(elem);
+                    });
+                    return;
+                }
+            }
+            
+            forEachCandidate(parent, states, [&](BasicElement& child, StateSet next) {
+                if(next & accepting())
+                    fn(child);
+                visit(child, next, fn, kinds);
+            });
+        }
+        
+        std::vector<Step> mSteps;
+    };
+}
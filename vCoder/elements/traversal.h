@@ -0,0 +1,291 @@
+//
+//  traversal.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "basicelement.h"
+
+namespace vcoder::elements
+{
+    /// @brief A forward iterator visiting a subtree in pre-order (parents before their children).
+    /// @remarks Walks the parent/sibling links: no recursion, no allocation. Mutating the tree invalidates it.
+    class PreOrderIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = BasicElement;
+        using difference_type = std::ptrdiff_t;
+        using pointer = BasicElement*;
+        using reference = BasicElement&;
+        
+        /// @brief Constructs the past-the-end iterator.
+        PreOrderIterator()
+        : mRoot(nullptr), mCurrent(nullptr), mDepth(0), mSkipChildren(false) {}
+        
+        /// @brief Constructs an iterator positioned at the subtree's root.
+        /// @param root The root of the subtree to visit
+        explicit PreOrderIterator(BasicElement* root)
+        : mRoot(root), mCurrent(root), mDepth(0), mSkipChildren(false) {}
+        
+        BasicElement& operator*() const { return *mCurrent; }
+        BasicElement* operator->() const { return mCurrent; }
+        
+        /// @brief Gets the depth of the current element relative to the subtree's root.
+        /// @return The current depth: 0 for the root itself
+        std::size_t depth() const { return mDepth; }
+        
+        /// @brief Makes the next increment skip the current element's children.
+        void skipChildren() { mSkipChildren = true; }
+        
+        PreOrderIterator& operator++()
+        {
+            auto child = mSkipChildren ? nullptr : mCurrent->firstChild();
+            mSkipChildren = false;
+            
+            if(child)
+            {
+                mCurrent = child;
+                mDepth++;
+                return *this;
+            }
+            
+            while(mCurrent != mRoot)
+            {
+                if(auto next = mCurrent->nextSibling())
+                {
+                    mCurrent = next;
+                    return *this;
+                }
+                
+                mCurrent = mCurrent->parent();
+                mDepth--;
+            }
+            
+            mCurrent = nullptr;
+            return *this;
+        }
+        
+        PreOrderIterator operator++(int)
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+        
+        bool operator==(const PreOrderIterator& other) const { return mCurrent == other.mCurrent; }
+        bool operator!=(const PreOrderIterator& other) const { return mCurrent != other.mCurrent; }
+    
+    private:
+        BasicElement* mRoot;
+        BasicElement* mCurrent;
+        std::size_t mDepth;
+        bool mSkipChildren;
+    };
+    
+    /// @brief A forward iterator visiting a subtree in post-order (children before their parents).
+    /// @remarks Walks the parent/sibling links: no recursion, no allocation. Mutating the tree invalidates it.
+    ///          Children are always visited before their parent is known, so there's no way to skip them here.
+    class PostOrderIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = BasicElement;
+        using difference_type = std::ptrdiff_t;
+        using pointer = BasicElement*;
+        using reference = BasicElement&;
+        
+        /// @brief Constructs the past-the-end iterator.
+        PostOrderIterator()
+        : mRoot(nullptr), mCurrent(nullptr), mDepth(0) {}
+        
+        /// @brief Constructs an iterator positioned at the subtree's first leaf.
+        /// @param root The root of the subtree to visit
+        explicit PostOrderIterator(BasicElement* root)
+        : mRoot(root), mCurrent(root), mDepth(0)
+        {
+            if(mCurrent)
+                descend();
+        }
+        
+        BasicElement& operator*() const { return *mCurrent; }
+        BasicElement* operator->() const { return mCurrent; }
+        
+        /// @brief Gets the depth of the current element relative to the subtree's root.
+        /// @return The current depth: 0 for the root itself
+        std::size_t depth() const { return mDepth; }
+        
+        PostOrderIterator& operator++()
+        {
+            if(mCurrent == mRoot)
+            {
+                mCurrent = nullptr;
+                return *this;
+            }
+            
+            if(auto next = mCurrent->nextSibling())
+            {
+                mCurrent = next;
+                descend();
+            }
+            else
+            {
+                mCurrent = mCurrent->parent();
+                mDepth--;
+            }
+            
+            return *this;
+        }
+        
+        PostOrderIterator operator++(int)
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+        
+        bool operator==(const PostOrderIterator& other) const { return mCurrent == other.mCurrent; }
+        bool operator!=(const PostOrderIterator& other) const { return mCurrent != other.mCurrent; }
+    
+    private:
+        void descend()
+        {
+            while(auto child = mCurrent->firstChild())
+            {
+                mCurrent = child;
+                mDepth++;
+            }
+        }
+        
+        BasicElement* mRoot;
+        BasicElement* mCurrent;
+        std::size_t mDepth;
+    };
+    
+    /// @brief A subtree range usable with range-based for loops and standard algorithms.
+    template<class Iterator>
+    class TraversalRange
+    {
+    public:
+        TraversalRange(BasicElement& root)
+        : mRoot(&root) {}
+        
+        Iterator begin() const { return Iterator(mRoot); }
+        Iterator end() const { return Iterator(); }
+    
+    private:
+        BasicElement* mRoot;
+    };
+    
+    /// @brief A single-pass range visiting a subtree level by level (breadth-first).
+    /// @remarks The pending elements are kept in one buffer owned by the range: it grows geometrically and gets
+    ///          compacted as levels are consumed, so stepping doesn't allocate. Iterators are input iterators.
+    class LevelOrderRange
+    {
+    public:
+        class Iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = BasicElement;
+            using difference_type = std::ptrdiff_t;
+            using pointer = BasicElement*;
+            using reference = BasicElement&;
+            
+            Iterator(LevelOrderRange* range = nullptr)
+            : mRange(range) {}
+            
+            BasicElement& operator*() const { return *mRange->current().first; }
+            BasicElement* operator->() const { return mRange->current().first; }
+            
+            /// @brief Gets the depth of the current element relative to the subtree's root.
+            /// @return The current depth: 0 for the root itself
+            std::size_t depth() const { return mRange->current().second; }
+            
+            /// @brief Prevents the current element's children from being queued.
+            void skipChildren() { mRange->mSkipChildren = true; }
+            
+            Iterator& operator++()
+            {
+                mRange->advance();
+                return *this;
+            }
+            
+            void operator++(int) { ++*this; }
+            
+            bool operator==(const Iterator& other) const { return atEnd() == other.atEnd(); }
+            bool operator!=(const Iterator& other) const { return atEnd() != other.atEnd(); }
+        
+        private:
+            bool atEnd() const { return !mRange || mRange->mHead == mRange->mQueue.size(); }
+            
+            LevelOrderRange* mRange;
+        };
+        
+        LevelOrderRange(BasicElement& root)
+        : mHead(0), mSkipChildren(false)
+        {
+            mQueue.emplace_back(&root, 0);
+        }
+        
+        LevelOrderRange(const LevelOrderRange&) = delete;
+        
+        Iterator begin() { return Iterator(this); }
+        Iterator end() { return Iterator(); }
+    
+    private:
+        const std::pair<BasicElement*, std::size_t>& current() const { return mQueue[mHead]; }
+        
+        void advance()
+        {
+            auto current = mQueue[mHead++];
+            
+            if(!mSkipChildren)
+                for(auto child = current.first->firstChild(); child; child = child->nextSibling())
+                    mQueue.emplace_back(child, current.second + 1);
+            mSkipChildren = false;
+            
+            // Drop the consumed prefix once it dominates the buffer: amortized O(1) per element
+            if(mHead >= 64 && mHead * 2 >= mQueue.size())
+            {
+                mQueue.erase(mQueue.begin(), mQueue.begin() + static_cast<std::ptrdiff_t>(mHead));
+                mHead = 0;
+            }
+        }
+        
+        std::vector<std::pair<BasicElement*, std::size_t>> mQueue;
+        std::size_t mHead;
+        bool mSkipChildren;
+    };
+    
+    /// @brief Visits an element and all of its descendants, parents first.
+    /// @param root The root of the subtree to visit
+    /// @return A range of PreOrderIterator
+    inline TraversalRange<PreOrderIterator> preOrder(BasicElement& root)
+    {
+        return TraversalRange<PreOrderIterator>(root);
+    }
+    
+    /// @brief Visits an element and all of its descendants, children first.
+    /// @param root The root of the subtree to visit
+    /// @return A range of PostOrderIterator
+    inline TraversalRange<PostOrderIterator> postOrder(BasicElement& root)
+    {
+        return TraversalRange<PostOrderIterator>(root);
+    }
+    
+    /// @brief Visits an element and all of its descendants level by level.
+    /// @param root The root of the subtree to visit
+    /// @return A single-pass range: keep it alive while iterating
+    inline LevelOrderRange levelOrder(BasicElement& root)
+    {
+        return LevelOrderRange(root);
+    }
+}
@@ -0,0 +1,484 @@
+//
+//  treediff.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "elements.h"
+#include "../common/cxbinary.h"
+
+namespace vcoder::elements
+{
+    /// @brief One step of an edit script.
+    /// @remarks Elements are referred to by id: the elements of the old tree by their pre-order index, inserted ones by
+    ///          ids following those.
+    struct Edit
+    {
+        enum class Kind : std::uint8_t
+        {
+            Insert,        // Creates node, without children, under parent after the sibling after
+            Move,          // Moves node under parent after the sibling after
+            Rename,        // Renames node to name
+            SetProperties, // Sets the CX properties of node
+            Delete         // Detaches node along with whatever is left below it
+        };
+        
+        static constexpr std::uint32_t kNone = UINT32_MAX;
+        
+        Kind kind;
+        std::uint32_t node;
+        std::uint32_t parent = kNone;
+        std::uint32_t after = kNone;             // kNone to go first
+        ElementKind elementKind = ElementKind::Namespace;
+        std::string name;
+        std::string properties;                  // In CX binary
+    };
+    
+    /// @brief The edits turning one tree into another.
+    struct EditScript
+    {
+        std::size_t baseHash = 0;     // The treeHash() of the old tree: a patch only applies to an equal tree
+        std::uint32_t baseSize = 0;   // The number of elements of the old tree
+        std::vector<Edit> edits;      // Inserts, moves, renames and property changes in pre-order of the new tree, then deletes
+    };
+    
+    namespace detail
+    {
+        /// @brief Gets an element's type-specific data in CX binary.
+        inline std::string propertiesOf(BasicElement& elem)
+        {
+            return visitElement(elem, [](auto& concrete) { return CX::SerializeBinary(concrete); });
+        }
+        
+        /// @brief Creates an element without children from its kind, name and type-specific data in CX binary.
+        inline BasicElement* makeElement(ElementKind kind, const std::string& name, const std::string& properties)
+        {
+            BasicElement* elem = nullptr;
+            switch(kind)
+            {
+                case ElementKind::Root: elem = new Root(); elem->setName(name); break;
+                case ElementKind::Namespace: elem = new Namespace(name); break;
+                case ElementKind::Function: elem = new Function(name); break;
+                case ElementKind::Type: elem = new Type(name); break;
+            }
+            visitElement(*elem, [&properties](auto& concrete) { CX::DeserializeBinary(properties, concrete); });
+            return elem;
+        }
+        
+        /// @brief Matches the elements of two trees and derives the edits from the matching.
+        class TreeDiff
+        {
+        public:
+            TreeDiff(BasicElement& from, BasicElement& to)
+            {
+                number(from, mOld, mOldIds);
+                number(to, mNew, mNewIds);
+                mOldMatch.assign(mOld.size(), Edit::kNone);
+                mNewMatch.assign(mNew.size(), Edit::kNone);
+                mScriptIds.assign(mNew.size(), Edit::kNone);
+            }
+            
+            EditScript run()
+            {
+                EditScript script;
+                script.baseHash = mOld[0]->treeHash();
+                script.baseSize = std::uint32_t(mOld.size());
+                
+                if(mOld[0]->treeEquals(*mNew[0], true))
+                    return script;
+                
+                match();
+                emit(script);
+                return script;
+            }
+        
+        private:
+            static void number(BasicElement& root, std::vector<BasicElement*>& nodes, std::unordered_map<const BasicElement*, std::uint32_t>& ids)
+            {
+                for(auto& elem : preOrder(root))
+                {
+                    ids.emplace(&elem, std::uint32_t(nodes.size()));
+                    nodes.push_back(&elem);
+                }
+            }
+            
+            static std::string keyOf(const BasicElement& elem)
+            {
+                return char(elem.kind()) + elem.name();
+            }
+            
+            void pair(std::uint32_t oldId, std::uint32_t newId)
+            {
+                mOldMatch[oldId] = newId;
+                mNewMatch[newId] = oldId;
+                
+                // The root isn't keyed: it's always paired with the other root
+                auto keyed = oldId ? mByKey.find(keyOf(*mOld[oldId])) : mByKey.end();
+                if(keyed != mByKey.end())
+                    keyed->second.unmatched--;
+            }
+            
+            bool unmatchedSubtree(BasicElement& elem) const
+            {
+                for(auto& desc : preOrder(elem))
+                    if(mOldMatch[mOldIds.at(&desc)] != Edit::kNone)
+                        return false;
+                return true;
+            }
+            
+            /// @brief Pairs two equal subtrees element by element.
+            void pairSubtrees(BasicElement& oldElem, BasicElement& newElem)
+            {
+                pair(mOldIds.at(&oldElem), mNewIds.at(&newElem));
+                for(auto a = oldElem.firstChild(), b = newElem.firstChild(); a; a = a->nextSibling(), b = b->nextSibling())
+                    pairSubtrees(*a, *b);
+            }
+            
+            /// @brief Finds an old subtree equal to a new one: among the siblings it would keep first, anywhere otherwise.
+            BasicElement* findEqual(BasicElement& elem, BasicElement* oldParent)
+            {
+                BasicElement* found = nullptr;
+                auto accept = [&](BasicElement& candidate) {
+                    if(!found && candidate.kind() == elem.kind() && candidate.treeEquals(elem, true) && unmatchedSubtree(candidate))
+                        found = &candidate;
+                };
+                
+                if(oldParent)
+                    oldParent->forEachChildNamed(elem.name(), accept);
+                if(found)
+                    return found;
+                
+                auto bucket = mByHash.find(elem.treeHash());
+                if(bucket == mByHash.end())
+                    return nullptr;
+                
+                // Matched candidates never become available again, so they're skipped for good
+                auto& candidates = bucket->second;
+                while(candidates.cursor < candidates.ids.size() && mOldMatch[candidates.ids[candidates.cursor]] != Edit::kNone)
+                    candidates.cursor++;
+                for(auto i = candidates.cursor; i < candidates.ids.size() && !found; i++)
+                    accept(*mOld[candidates.ids[i]]);
+                return found;
+            }
+            
+            /// @brief Finds the old element with the same kind and name: among the siblings it would keep first,
+            ///        anywhere otherwise as long as there's only one.
+            BasicElement* findSameKey(BasicElement& elem, BasicElement* oldParent)
+            {
+                BasicElement* found = nullptr;
+                if(oldParent)
+                {
+                    oldParent->forEachChildNamed(elem.name(), [&](BasicElement& candidate) {
+                        if(!found && candidate.kind() == elem.kind() && mOldMatch[mOldIds.at(&candidate)] == Edit::kNone)
+                            found = &candidate;
+                    });
+                    if(found)
+                        return found;
+                }
+                
+                // Scanned only once per key: the count drops to 0 right after
+                auto keyed = mByKey.find(keyOf(elem));
+                if(keyed == mByKey.end() || keyed->second.unmatched != 1)
+                    return nullptr;
+                
+                for(auto id : keyed->second.ids)
+                    if(mOldMatch[id] == Edit::kNone)
+                        return mOld[id];
+                return nullptr;
+            }
+            
+            /// @brief Finds the old sibling a renamed element most likely was: the first unmatched one of the same kind
+            ///        whose name no new element of that kind still has, as that one would rather be kept elsewhere.
+            /// @remarks An old parent's candidates are listed by kind on first use and skipped for good once matched:
+            ///          the new tree's names don't change while matching, so neither does the list.
+            BasicElement* findRenamed(BasicElement& elem, BasicElement* oldParent)
+            {
+                if(!oldParent)
+                    return nullptr;
+                
+                auto listed = mRenamable.find(oldParent);
+                if(listed == mRenamable.end())
+                {
+                    listed = mRenamable.emplace(oldParent, std::vector<Bucket>()).first;
+                    for(auto candidate = oldParent->firstChild(); candidate; candidate = candidate->nextSibling())
+                    {
+                        auto id = mOldIds.at(candidate);
+                        if(mOldMatch[id] != Edit::kNone || mNewKeys.count(keyOf(*candidate)))
+                            continue;
+                        
+                        auto kind = std::size_t(candidate->kind());
+                        if(kind >= listed->second.size())
+                            listed->second.resize(kind + 1);
+                        listed->second[kind].ids.push_back(id);
+                    }
+                }
+                
+                auto kind = std::size_t(elem.kind());
+                if(kind >= listed->second.size())
+                    return nullptr;
+                
+                auto& candidates = listed->second[kind];
+                while(candidates.cursor < candidates.ids.size() && mOldMatch[candidates.ids[candidates.cursor]] != Edit::kNone)
+                    candidates.cursor++;
+                return candidates.cursor < candidates.ids.size() ? mOld[candidates.ids[candidates.cursor]] : nullptr;
+            }
+            
+            /// @brief Matches top-down: whole equal subtrees by hash first, then single elements by kind and name, then
+            ///        renamed ones by position.
+            void match()
+            {
+                for(std::uint32_t id = 1; id < mOld.size(); id++)
+                {
+                    mByHash[mOld[id]->treeHash()].ids.push_back(id);
+                    auto& keyed = mByKey[keyOf(*mOld[id])];
+                    keyed.ids.push_back(id);
+                    keyed.unmatched++;
+                }
+                for(std::uint32_t id = 1; id < mNew.size(); id++)
+                    mNewKeys.insert(keyOf(*mNew[id]));
+                
+                pair(0, 0);
+                for(std::uint32_t id = 1; id < mNew.size(); id++)
+                {
+                    if(mNewMatch[id] != Edit::kNone)
+                        continue;
+                    
+                    auto& elem = *mNew[id];
+                    auto parentMatch = mNewMatch[mNewIds.at(elem.parent())];
+                    auto oldParent = parentMatch == Edit::kNone ? nullptr : mOld[parentMatch];
+                    
+                    if(auto equal = findEqual(elem, oldParent))
+                        pairSubtrees(*equal, elem);
+                    else if(auto same = findSameKey(elem, oldParent))
+                        pair(mOldIds.at(same), id);
+                    else if(auto renamed = findRenamed(elem, oldParent))
+                        pair(mOldIds.at(renamed), id);
+                }
+            }
+            
+            /// @brief Finds the children of a new element that can stay where they are: the longest run of children
+            ///        matched under its old counterpart whose old order is kept.
+            std::vector<bool> staying(BasicElement& parent, std::uint32_t oldParent) const
+            {
+                std::vector<BasicElement*> children;
+                std::vector<std::uint32_t> positions; // Old position of each child, kNone if it comes from elsewhere
+                for(auto child = parent.firstChild(); child; child = child->nextSibling())
+                {
+                    auto match = mNewMatch[mNewIds.at(child)];
+                    children.push_back(child);
+                    positions.push_back(match != Edit::kNone && mOld[match]->parent() == mOld[oldParent] ? match : Edit::kNone);
+                }
+                
+                // Longest increasing subsequence of the old positions (pre-order ids grow with sibling order)
+                std::vector<std::size_t> tails, previous(children.size(), SIZE_MAX);
+                for(std::size_t i = 0; i < children.size(); i++)
+                {
+                    if(positions[i] == Edit::kNone)
+                        continue;
+                    
+                    auto slot = std::lower_bound(tails.begin(), tails.end(), positions[i], [&](std::size_t index, std::uint32_t position) {
+                        return positions[index] < position;
+                    });
+                    if(slot != tails.begin())
+                        previous[i] = *(slot - 1);
+                    if(slot == tails.end())
+                        tails.push_back(i);
+                    else
+                        *slot = i;
+                }
+                
+                std::vector<bool> result(children.size(), false);
+                for(auto i = tails.empty() ? SIZE_MAX : tails.back(); i != SIZE_MAX; i = previous[i])
+                    result[i] = true;
+                return result;
+            }
+            
+            void emit(EditScript& script)
+            {
+                auto nextId = std::uint32_t(mOld.size());
+                mScriptIds[0] = 0;
+                
+                for(std::uint32_t id = 0; id < mNew.size(); id++)
+                {
+                    auto& parent = *mNew[id];
+                    auto parentMatch = mNewMatch[id];
+                    auto stays = parentMatch == Edit::kNone ? std::vector<bool>() : staying(parent, parentMatch);
+                    
+                    std::size_t index = 0;
+                    auto after = Edit::kNone;
+                    for(auto child = parent.firstChild(); child; child = child->nextSibling(), index++)
+                    {
+                        auto childId = mNewIds.at(child);
+                        auto match = mNewMatch[childId];
+                        
+                        Edit edit;
+                        edit.parent = mScriptIds[id];
+                        edit.after = after;
+                        if(match == Edit::kNone)
+                        {
+                            edit.kind = Edit::Kind::Insert;
+                            edit.node = mScriptIds[childId] = nextId++;
+                            edit.elementKind = child->kind();
+                            edit.name = child->name();
+                            edit.properties = propertiesOf(*child);
+                            script.edits.push_back(std::move(edit));
+                        }
+                        else
+                        {
+                            mScriptIds[childId] = match;
+                            if(stays.empty() || !stays[index])
+                            {
+                                edit.kind = Edit::Kind::Move;
+                                edit.node = match;
+                                script.edits.push_back(std::move(edit));
+                            }
+                            changes(*mOld[match], *child, match, script);
+                        }
+                        
+                        after = mScriptIds[childId];
+                    }
+                }
+                
+                if(mNew[0]->name() != mOld[0]->name() || !mOld[0]->specificEquals(*mNew[0]))
+                    changes(*mOld[0], *mNew[0], 0, script);
+                
+                // Only the topmost unmatched old elements: their unmatched descendants go with them
+                for(std::uint32_t id = 1; id < mOld.size(); id++)
+                    if(mOldMatch[id] == Edit::kNone && mOldMatch[mOldIds.at(mOld[id]->parent())] != Edit::kNone)
+                    {
+                        Edit edit;
+                        edit.kind = Edit::Kind::Delete;
+                        edit.node = id;
+                        script.edits.push_back(std::move(edit));
+                    }
+            }
+            
+            void changes(BasicElement& oldElem, BasicElement& newElem, std::uint32_t id, EditScript& script) const
+            {
+                if(oldElem.name() != newElem.name())
+                {
+                    Edit edit;
+                    edit.kind = Edit::Kind::Rename;
+                    edit.node = id;
+                    edit.name = newElem.name();
+                    script.edits.push_back(std::move(edit));
+                }
+                
+                if(!oldElem.specificEquals(newElem))
+                {
+                    Edit edit;
+                    edit.kind = Edit::Kind::SetProperties;
+                    edit.node = id;
+                    edit.properties = propertiesOf(newElem);
+                    script.edits.push_back(std::move(edit));
+                }
+            }
+            
+            struct Bucket
+            {
+                std::vector<std::uint32_t> ids;
+                std::size_t cursor = 0;     // Every id before it is matched
+            };
+            
+            struct KeyBucket
+            {
+                std::vector<std::uint32_t> ids;
+                std::size_t unmatched = 0;
+            };
+            
+            std::vector<BasicElement*> mOld, mNew; // In pre-order
+            std::unordered_map<const BasicElement*, std::uint32_t> mOldIds, mNewIds;
+            std::vector<std::uint32_t> mOldMatch, mNewMatch;
+            std::vector<std::uint32_t> mScriptIds; // The script id of each new element
+            std::unordered_map<std::size_t, Bucket> mByHash;
+            std::unordered_map<std::string, KeyBucket> mByKey;
+            std::unordered_set<std::string> mNewKeys; // The kind and name of every new element
+            std::unordered_map<const BasicElement*, std::vector<Bucket>> mRenamable; // Per old parent, by kind
+        };
+    }
+    
+    /// @brief Computes the edits turning one tree into another, keeping track of element identity.
+    /// @param from The old tree
+    /// @param to The new tree
+    /// @return The edit script: applyPatch() replays it
+    /// @remarks Elements are matched top-down, in pre-order of the new tree: an element whose whole subtree has an equal
+    ///          in the old tree is paired with it through treeHash(), preferring the siblings it would keep; otherwise it's
+    ///          paired with the old element of the same kind and name under its parent's counterpart, or anywhere if
+    ///          that one is unique. Matched elements under the same parent keep their place when they're part of the
+    ///          longest run still in the old order, and are moved otherwise. It costs O(n log n) on typical edits, with
+    ///          unchanged subtrees compared in O(1) through their cached hashes.
+    inline EditScript diffTrees(BasicElement& from, BasicElement& to)
+    {
+        return detail::TreeDiff(from, to).run();
+    }
+    
+    /// @brief Applies an edit script to a tree equal to the one it was computed from.
+    /// @param root The tree to patch: new elements are allocated from the current ArenaScope, if any
+    /// @param script The edit script
+    /// @return The subtrees the script deleted: they're only detached, the caller deletes them
+    /// @remarks Throws std::runtime_error if the tree isn't equal to the script's old tree, leaving it untouched.
+    inline std::vector<BasicElement*> applyPatch(BasicElement& root, const EditScript& script)
+    {
+        if(root.treeHash() != script.baseHash)
+            throw std::runtime_error("The patch doesn't apply to this tree");
+        
+        std::vector<BasicElement*> nodes;
+        nodes.reserve(script.baseSize);
+        for(auto& elem : preOrder(root))
+            nodes.push_back(&elem);
+        
+        auto place = [&nodes](const Edit& edit, BasicElement* elem) {
+            auto parent = nodes.at(edit.parent);
+            auto before = edit.after == Edit::kNone ? parent->firstChild() : nodes.at(edit.after)->nextSibling();
+            parent->insertChild(elem, before);
+        };
+        
+        std::vector<BasicElement*> deleted;
+        for(auto& edit : script.edits)
+        {
+            switch(edit.kind)
+            {
+                case Edit::Kind::Insert:
+                {
+                    auto elem = detail::makeElement(edit.elementKind, edit.name, edit.properties);
+                    if(nodes.size() <= edit.node)
+                        nodes.resize(edit.node + 1, nullptr);
+                    nodes[edit.node] = elem;
+                    place(edit, elem);
+                    break;
+                }
+                case Edit::Kind::Move:
+                    place(edit, nodes.at(edit.node));
+                    break;
+                case Edit::Kind::Rename:
+                    nodes.at(edit.node)->setName(edit.name);
+                    break;
+                case Edit::Kind::SetProperties:
+                {
+                    auto elem = nodes.at(edit.node);
+                    visitElement(*elem, [&edit](auto& concrete) { CX::DeserializeBinary(edit.properties, concrete); });
+                    elem->specificChanged();
+                    break;
+                }
+                case Edit::Kind::Delete:
+                {
+                    auto elem = nodes.at(edit.node);
+                    elem->parent()->removeChild(elem);
+                    deleted.push_back(elem);
+                    break;
+                }
+            }
+        }
+        return deleted;
+    }
+}
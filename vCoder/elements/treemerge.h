@@ -0,0 +1,334 @@
+//
+//  treemerge.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "treediff.h"
+
+namespace vcoder::elements
+{
+    /// @brief A spot where both sides of a merge changed the same thing in different ways: the merged tree keeps ours.
+    struct MergeConflict
+    {
+        enum class Kind : std::uint8_t
+        {
+            Rename,       // Both renamed the element, to different names
+            Properties,   // Both changed the element's type-specific data, differently
+            AddAdd,       // Both added a child with the same kind and name, but different subtrees
+            DeleteModify, // Theirs deleted a subtree ours changed: it's kept
+            ModifyDelete, // Ours deleted a subtree theirs changed: it stays deleted
+            Order         // Both reordered the element's children, differently
+        };
+        
+        Kind kind;
+        BasicElement* ours;   // The element in the merged tree: nullptr for ModifyDelete
+        BasicElement* theirs; // Its counterpart in theirs: nullptr for DeleteModify
+        BasicElement* base;   // Its counterpart in the base: nullptr for AddAdd
+    };
+    
+    /// @brief The outcome of mergeTrees().
+    struct MergeResult
+    {
+        std::vector<MergeConflict> conflicts;
+        std::vector<BasicElement*> removed; // The subtrees theirs deleted: only detached from ours, the caller deletes them
+    };
+    
+    namespace detail
+    {
+        /// @brief Brings the changes from base to theirs into ours, top-down through the parts theirs changed.
+        class TreeMerge
+        {
+        public:
+            explicit TreeMerge(const std::function<void(BasicElement&)>& willChange)
+            : mWillChange(willChange) {}
+            
+            MergeResult run(BasicElement& base, BasicElement& ours, BasicElement& theirs)
+            {
+                if(ours.kind() != base.kind() || theirs.kind() != base.kind())
+                    throw std::runtime_error("The trees to merge have different roots");
+                
+                merge(base, ours, theirs);
+                return std::move(mResult);
+            }
+        
+        private:
+            /// @brief The children of a base element paired with those of one side.
+            struct Pairing
+            {
+                std::vector<BasicElement*> base;                                 // In order
+                std::vector<BasicElement*> counterparts;                         // Per base child: nullptr if the side dropped it
+                std::unordered_map<const BasicElement*, std::size_t> baseIndex;  // Per child of the side that has a counterpart
+            };
+            
+            static constexpr std::size_t kUnpaired = SIZE_MAX;
+            
+            void merge(BasicElement& base, BasicElement& ours, BasicElement& theirs)
+            {
+                // Theirs left the subtree alone, or did the same as ours: ours is the merge already. Hashes aren't
+                // verified, as that would walk every skipped subtree (see mergeTrees())
+                if(theirs.treeEquals(base) || theirs.treeEquals(ours))
+                    return;
+                
+                if(theirs.name() != base.name() && theirs.name() != ours.name())
+                {
+                    if(ours.name() == base.name())
+                        ours.setName(theirs.name());
+                    else
+                        conflict(MergeConflict::Kind::Rename, &ours, &theirs, &base);
+                }
+                
+                if(!theirs.specificEquals(base) && !theirs.specificEquals(ours))
+                {
+                    if(ours.specificEquals(base))
+                    {
+                        if(mWillChange)
+                            mWillChange(ours);
+                        auto properties = propertiesOf(theirs);
+                        visitElement(ours, [&properties](auto& concrete) { CX::DeserializeBinary(properties, concrete); });
+                        ours.specificChanged();
+                    }
+                    else
+                        conflict(MergeConflict::Kind::Properties, &ours, &theirs, &base);
+                }
+                
+                mergeChildren(base, ours, theirs);
+            }
+            
+            void mergeChildren(BasicElement& base, BasicElement& ours, BasicElement& theirs)
+            {
+                auto mine = pairChildren(base, ours);
+                auto other = pairChildren(base, theirs);
+                
+                // Where each child of either side ends up in the merged tree: nullptr if it doesn't
+                std::unordered_map<const BasicElement*, BasicElement*> merged;
+                for(auto child = ours.firstChild(); child; child = child->nextSibling())
+                    merged[child] = child;
+                
+                for(std::size_t i = 0; i < mine.base.size(); i++)
+                {
+                    auto b = mine.base[i], o = mine.counterparts[i], t = other.counterparts[i];
+                    if(o && t)
+                    {
+                        merged[t] = o;
+                        merge(*b, *o, *t);
+                    }
+                    else if(o)
+                    {
+                        if(!o->treeEquals(*b))
+                            conflict(MergeConflict::Kind::DeleteModify, o, nullptr, b);
+                        else
+                        {
+                            ours.removeChild(o);
+                            mResult.removed.push_back(o);
+                            merged[o] = nullptr;
+                        }
+                    }
+                    else if(t)
+                    {
+                        merged[t] = nullptr;
+                        if(!t->treeEquals(*b))
+                            conflict(MergeConflict::Kind::ModifyDelete, nullptr, t, b);
+                    }
+                }
+                
+                // Children theirs added: the same addition on both sides is taken once, different ones are conflicts
+                std::unordered_set<const BasicElement*> claimed;
+                for(auto t = theirs.firstChild(); t; t = t->nextSibling())
+                {
+                    if(other.baseIndex.count(t))
+                        continue;
+                    
+                    BasicElement* added = nullptr;
+                    ours.forEachChildNamed(t->name(), [&](BasicElement& candidate) {
+                        if(!added && candidate.kind() == t->kind() && !mine.baseIndex.count(&candidate) && !claimed.count(&candidate))
+                            added = &candidate;
+                    });
+                    
+                    if(added)
+                    {
+                        claimed.insert(added);
+                        if(!added->treeEquals(*t))
+                            conflict(MergeConflict::Kind::AddAdd, added, t, nullptr);
+                    }
+                    else
+                        added = copyTree(*t);
+                    merged[t] = added;
+                }
+                
+                arrange(base, ours, theirs, mine, other, merged);
+            }
+            
+            /// @brief Puts the children of ours in their merged order: the order of the side that reordered the
+            ///        children both kept, if only one did, with the children only the other side has following the
+            ///        same siblings as there.
+            void arrange(BasicElement& base, BasicElement& ours, BasicElement& theirs, const Pairing& mine, const Pairing& other,
+                         const std::unordered_map<const BasicElement*, BasicElement*>& merged)
+            {
+                auto kept = [&](BasicElement* parent, const Pairing& pairing, const Pairing& opposite) {
+                    std::vector<std::size_t> order;
+                    for(auto child = parent->firstChild(); child; child = child->nextSibling())
+                    {
+                        auto found = pairing.baseIndex.find(child);
+                        if(found != pairing.baseIndex.end() && opposite.counterparts[found->second])
+                            order.push_back(found->second);
+                    }
+                    return order;
+                };
+                
+                auto oursOrder = kept(&ours, mine, other);
+                auto theirsOrder = kept(&theirs, other, mine);
+                auto oursMoved = !std::is_sorted(oursOrder.begin(), oursOrder.end());
+                auto theirsMoved = !std::is_sorted(theirsOrder.begin(), theirsOrder.end());
+                if(oursMoved && theirsMoved && oursOrder != theirsOrder)
+                    conflict(MergeConflict::Kind::Order, &ours, &theirs, &base);
+                
+                auto mapped = [&merged](BasicElement& parent) {
+                    std::vector<BasicElement*> result;
+                    for(auto child = parent.firstChild(); child; child = child->nextSibling())
+                    {
+                        auto found = merged.find(child);
+                        if(found != merged.end() && found->second)
+                            result.push_back(found->second);
+                    }
+                    return result;
+                };
+                
+                auto takeTheirs = theirsMoved && !oursMoved;
+                auto primary = mapped(takeTheirs ? theirs : ours);
+                auto secondary = mapped(takeTheirs ? ours : theirs);
+                
+                // Elements the primary side doesn't have follow their preceding sibling on the secondary side
+                std::unordered_set<BasicElement*> inPrimary(primary.begin(), primary.end());
+                std::unordered_map<BasicElement*, std::vector<BasicElement*>> following;
+                BasicElement* anchor = nullptr;
+                for(auto elem : secondary)
+                {
+                    if(!inPrimary.count(elem))
+                        following[anchor].push_back(elem);
+                    anchor = elem;
+                }
+                
+                std::vector<BasicElement*> order;
+                std::function<void(BasicElement*)> emit = [&](BasicElement* elem) {
+                    order.push_back(elem);
+                    auto found = following.find(elem);
+                    if(found != following.end())
+                        for(auto next : found->second)
+                            emit(next);
+                };
+                emit(nullptr);
+                for(auto elem : primary)
+                    emit(elem);
+                
+                // Only children out of place are touched
+                BasicElement* previous = nullptr;
+                for(std::size_t i = 1; i < order.size(); i++)
+                {
+                    auto elem = order[i];
+                    auto before = previous ? previous->nextSibling() : ours.firstChild();
+                    if(elem != before)
+                        ours.insertChild(elem, before);
+                    previous = elem;
+                }
+            }
+            
+            /// @brief Pairs the children of a base element with those of one side: by kind and name, preferring equal
+            ///        subtrees among namesakes, then renamed ones by kind as long as nothing else about them changed.
+            static Pairing pairChildren(BasicElement& base, BasicElement& side)
+            {
+                Pairing pairing;
+                std::unordered_map<const BasicElement*, std::size_t> indexes;
+                for(auto child = base.firstChild(); child; child = child->nextSibling())
+                {
+                    indexes.emplace(child, pairing.base.size());
+                    pairing.base.push_back(child);
+                }
+                pairing.counterparts.assign(pairing.base.size(), nullptr);
+                
+                std::vector<BasicElement*> unpaired;
+                for(auto child = side.firstChild(); child; child = child->nextSibling())
+                {
+                    auto found = kUnpaired;
+                    base.forEachChildNamed(child->name(), [&](BasicElement& candidate) {
+                        auto index = indexes.at(&candidate);
+                        if(candidate.kind() != child->kind() || pairing.counterparts[index])
+                            return;
+                        if(found == kUnpaired || (candidate.treeEquals(*child) && !pairing.base[found]->treeEquals(*child)))
+                            found = index;
+                    });
+                    
+                    if(found == kUnpaired)
+                        unpaired.push_back(child);
+                    else
+                        pair(pairing, found, child);
+                }
+                
+                for(auto child : unpaired)
+                    for(std::size_t i = 0; i < pairing.base.size(); i++)
+                    {
+                        auto candidate = pairing.base[i];
+                        if(!pairing.counterparts[i] && candidate->kind() == child->kind() && candidate->specificEquals(*child) &&
+                           candidate->childCount() == child->childCount() && !side.findChild(candidate->name()))
+                        {
+                            pair(pairing, i, child);
+                            break;
+                        }
+                    }
+                return pairing;
+            }
+            
+            static void pair(Pairing& pairing, std::size_t index, BasicElement* child)
+            {
+                pairing.counterparts[index] = child;
+                pairing.baseIndex.emplace(child, index);
+            }
+            
+            static BasicElement* copyTree(BasicElement& elem)
+            {
+                auto copy = makeElement(elem.kind(), elem.name(), propertiesOf(elem));
+                for(auto child = elem.firstChild(); child; child = child->nextSibling())
+                    copy->addChild(copyTree(*child));
+                return copy;
+            }
+            
+            void conflict(MergeConflict::Kind kind, BasicElement* ours, BasicElement* theirs, BasicElement* base)
+            {
+                mResult.conflicts.push_back({ kind, ours, theirs, base });
+            }
+            
+            std::function<void(BasicElement&)> mWillChange;
+            MergeResult mResult;
+        };
+    }
+    
+    /// @brief Merges two trees derived from a common base: the changes from the base to theirs are made to ours.
+    /// @param base The common base
+    /// @param ours The tree to merge into: new elements are allocated from the current ArenaScope, if any
+    /// @param theirs The other tree: left untouched, its elements are copied
+    /// @param willChange Called with an element of ours before its type-specific data gets changed, e.g. for undo
+    /// @return The conflicts and the subtrees removed from ours
+    /// @remarks Elements are paired by kind and name under paired parents. A child left without a namesake is paired
+    ///          as renamed with a base child of the same kind, type-specific data and number of children whose name
+    ///          that side doesn't use anymore. The trees are walked top-down through the subtrees theirs changed only:
+    ///          a subtree whose treeHash() matches the base's, or ours', is skipped in O(1), so the merge costs
+    ///          O(children of the changed elements) however large the trees. Equal hashes are trusted without a full
+    ///          comparison, which would cost O(subtree) for every skipped subtree: a 64-bit collision would make
+    ///          theirs' change to that subtree look like no change, and be dropped. A subtree theirs moved to another
+    ///          parent is merged as a deletion and an addition. Conflicting changes keep ours' side and are reported.
+    inline MergeResult mergeTrees(BasicElement& base, BasicElement& ours, BasicElement& theirs,
+                                  const std::function<void(BasicElement&)>& willChange = nullptr)
+    {
+        return detail::TreeMerge(willChange).run(base, ours, theirs);
+    }
+}
@@ -14,7 +14,10 @@ namespace vcoder::elements
     class Type : public BasicElement
     {
     public:
-        Type(const std::string& name = "") : BasicElement(name)
+        /// @brief The kind every Type has.
+        static constexpr ElementKind Kind = ElementKind::Type;
+        
+        Type(const std::string& name = "") : BasicElement(Kind, name)
         {}
         
         /// @brief Implements BasicElement::type().
@@ -31,6 +34,22 @@ namespace vcoder::elements
             return vcoder::common::CXSerializable<BasicElement::SerializationFormat, Type>(*this);
         }
         
+        /// @brief Implements BasicElement::specificHash().
+        /// @return The hash of this element's CX properties
+        virtual std::size_t specificHash() const override
+        {
+            return CX::Hash(*this);
+        }
+        
+        /// @brief Implements BasicElement::specificEquals().
+        /// @param other The element to compare with
+        /// @return Whether both elements are Types with equal CX properties
+        virtual bool specificEquals(const BasicElement& other) const override
+        {
+            auto that = other.as<Type>();
+            return that && CX::Equal(*this, *that);
+        }
+        
         CXPROPS(Type) (
                        CXPROP(isType)
                        ) CXPROPS_END;
@@ -0,0 +1,78 @@
+//
+//  visitor.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <stdexcept>
+#include <utility>
+
+#include "basicelement.h"
+#include "root.h"
+#include "namespace.h"
+#include "function.h"
+#include "type.h"
+
+namespace vcoder::elements
+{
+    /// @brief Combines several lambdas into one visitor, one overload per lambda.
+    /// @remarks visitElement(elem, Overloaded { [](Function& fn) {...}, [](BasicElement& other) {...} });
+    template<class... Handlers>
+    struct Overloaded : Handlers...
+    {
+        using Handlers::operator()...;
+    };
+    
+    template<class... Handlers>
+    Overloaded(Handlers...) -> Overloaded<Handlers...>;
+    
+    /// @brief Calls the visitor with the element downcast to its concrete class.
+    /// @param elem The element to visit
+    /// @param visitor The visitor: must be callable with Root&, Namespace&, Function& and Type& (a BasicElement& overload
+    ///        catches the rest) and return the same type for all of them
+    /// @return Whatever the visitor returns
+    /// @remarks Dispatches through a switch on the stored kind: the handler for each kind is picked at compile time, so
+    ///          there are no type() string compares or dynamic_casts per element.
+    template<class Visitor>
+    decltype(auto) visitElement(BasicElement& elem, Visitor&& visitor)
+    {
+        switch(elem.kind())
+        {
+            case ElementKind::Root:
+                return std::forward<Visitor>(visitor)(static_cast<Root&>(elem));
+            case ElementKind::Namespace:
+                return std::forward<Visitor>(visitor)(static_cast<Namespace&>(elem));
+            case ElementKind::Function:
+                return std::forward<Visitor>(visitor)(static_cast<Function&>(elem));
+            case ElementKind::Type:
+                return std::forward<Visitor>(visitor)(static_cast<Type&>(elem));
+        }
+        
+        throw std::logic_error("Unknown element kind");
+    }
+    
+    /// @brief Calls the visitor with the element downcast to its concrete class.
+    /// @param elem The element to visit
+    /// @param visitor The visitor: must be callable with const Root&, const Namespace&, const Function& and const Type&
+    ///        and return the same type for all of them
+    /// @return Whatever the visitor returns
+    template<class Visitor>
+    decltype(auto) visitElement(const BasicElement& elem, Visitor&& visitor)
+    {
+        switch(elem.kind())
+        {
+            case ElementKind::Root:
+                return std::forward<Visitor>(visitor)(static_cast<const Root&>(elem));
+            case ElementKind::Namespace:
+                return std::forward<Visitor>(visitor)(static_cast<const Namespace&>(elem));
+            case ElementKind::Function:
+                return std::forward<Visitor>(visitor)(static_cast<const Function&>(elem));
+            case ElementKind::Type:
+                return std::forward<Visitor>(visitor)(static_cast<const Type&>(elem));
+        }
+        
+        throw std::logic_error("Unknown element kind");
+    }
+}
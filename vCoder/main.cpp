@@ -10,17 +10,20 @@
 #include <fstream>
 #include <sstream>
 #include "elements/elements.h"
+#include "model/document.h"
 #include "common/serializable.h"
 #include "common/json.hpp"
 
-void printout(vcoder::elements::BasicElement& elem, int tabs = 0)
+void printout(vcoder::elements::BasicElement& root)
 {
-    for(int i = 0; i < tabs; i++)
-        putchar('\t');
-    
-    printf("[%s] %s\n", elem.type().c_str(), elem.name().c_str());
-    
-    elem.forAllChildren([tabs](vcoder::elements::BasicElement& elem) { printout(elem, tabs + 1); });
+    auto range = vcoder::elements::preOrder(root);
+    for(auto it = range.begin(); it != range.end(); ++it)
+    {
+        for(std::size_t i = 0; i < it.depth(); i++)
+            putchar('\t');
+        
+        printf("[%s] %s\n", it->type().c_str(), it->name().c_str());
+    }
 }
 
 void Serialize(const vcoder::common::ISerializable<nlohmann::json>& obj)
@@ -29,12 +32,7 @@ void Serialize(const vcoder::common::ISerializable<nlohmann::json>& obj)
 }
 
 int main(int argc, const char * argv[]) {
-    using namespace vcoder::elements;
-    std::ifstream f("/Users/osdever/Documents/XCode/vCoder/vCoder/model.json");
-    std::stringstream ss;
-    ss << f.rdbuf();
-    auto mdl = ss.str();
-    
-    auto pElement = std::unique_ptr<BasicElement>(BasicElement::deserialize(nlohmann::json::parse(mdl)));
-    printout(*pElement);
+    vcoder::model::Document document;
+    document.load("/Users/osdever/Documents/XCode/vCoder/vCoder/model.json");
+    printout(*document.root());
 }
@@ -0,0 +1,289 @@
+//
+//  changefeed.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../elements/elements.h"
+
+namespace vcoder::model
+{
+    /// @brief The net change of one element over a batch.
+    struct Change
+    {
+        enum class Kind : std::uint8_t
+        {
+            Added,             // The element and its subtree entered the tree: nothing is reported for its descendants
+            Removed,           // The element and its subtree left the tree
+            Moved,             // The element got a new parent or position
+            Renamed,
+            PropertiesChanged
+        };
+        
+        Kind kind;
+        elements::BasicElement* element;
+        elements::BasicElement* parent;    // The new parent when Added or Moved, the previous one when Removed
+        elements::BasicElement* oldParent; // The previous parent when Moved
+        std::string oldName;               // The previous name when Renamed
+    };
+    
+    /// @brief An interface to receive batches of changes from a ChangeFeed.
+    class ChangeListener
+    {
+    public:
+        virtual ~ChangeListener() {}
+        
+        /// @brief Called once per batch with at least one change.
+        /// @param changes The changes: an element appears once per kind at most, Added and Removed elements only once
+        virtual void onChanges(const std::vector<Change>& changes) = 0;
+    };
+    
+    /// @brief Collects the changes of an element tree and delivers them to listeners in batches, coalesced per element.
+    /// @remarks Changes to an element are folded into its net change since the last flush: adding then removing it
+    ///          cancels out, as does renaming it back, and an element removed then added is reported as moved. Added
+    ///          and removed subtrees are reported by their roots only. Elements that left the tree may be deleted by
+    ///          the time the batch is delivered: only Removed changes can point to such elements, and their pointers
+    ///          are only good as keys then.
+    class ChangeFeed : public elements::TreeObserver
+    {
+    public:
+        ChangeFeed()
+        : mRoot(nullptr) {}
+        
+        ChangeFeed(const ChangeFeed&) = delete;
+        
+        ~ChangeFeed()
+        {
+            detach();
+        }
+        
+        /// @brief Starts collecting the changes of a tree.
+        /// @param root The tree's topmost element
+        void attach(elements::BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+        }
+        
+        /// @brief Stops collecting and drops the pending changes.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            mEntries.clear();
+            mPending.clear();
+            mDetachedBy.clear();
+            mRoot = nullptr;
+        }
+        
+        /// @brief Registers a listener.
+        /// @param listener The listener: must outlive the feed or be removed first
+        void addListener(ChangeListener* listener)
+        {
+            mListeners.push_back(listener);
+        }
+        
+        /// @brief Unregisters a listener.
+        /// @param listener The listener
+        void removeListener(ChangeListener* listener)
+        {
+            mListeners.erase(std::remove(mListeners.begin(), mListeners.end(), listener), mListeners.end());
+        }
+        
+        /// @brief Gets the number of elements touched since the last flush.
+        /// @return The element count, including those whose changes cancel out
+        std::size_t pending() const
+        {
+            return mEntries.size();
+        }
+        
+        /// @brief Delivers the changes made since the last flush as one batch, unless they cancel out.
+        void flush()
+        {
+            std::vector<Change> changes;
+            for(auto& entry : mEntries)
+                collect(entry, changes);
+            
+            mEntries.clear();
+            mPending.clear();
+            mDetachedBy.clear();
+            
+            if(changes.empty())
+                return;
+            
+            for(auto listener : mListeners)
+                listener->onChanges(changes);
+        }
+        
+        virtual void onChildAdded(elements::BasicElement& parent, elements::BasicElement& child) override
+        {
+            auto& entry = touch(child, false);
+            entry.inTree = true;
+            entry.repositioned = true;
+            entry.parent = &parent;
+            
+            // Whatever left the tree with the subtree is back
+            auto detached = mDetachedBy.find(&child);
+            if(detached != mDetachedBy.end())
+            {
+                for(auto index : detached->second)
+                    mEntries[index].detachedWith = nullptr;
+                mDetachedBy.erase(detached);
+            }
+            entry.detachedWith = nullptr;
+        }
+        
+        virtual void onChildRemoving(elements::BasicElement& parent, elements::BasicElement& child) override
+        {
+            auto& entry = touch(child, true);
+            entry.inTree = false;
+            entry.repositioned = true;
+            entry.parent = nullptr;
+            
+            // Descendants touched earlier leave the tree too, and may get deleted before the next flush. They're found
+            // through the subtree when it's smaller than the batch, through the entries still in the tree otherwise:
+            // the others may be deleted already
+            auto index = mPending.at(&child);
+            std::vector<std::size_t> detached;
+            std::size_t visited = 0;
+            auto range = elements::preOrder(child);
+            auto it = ++range.begin();
+            for(; it != range.end() && visited < mEntries.size(); ++it, visited++)
+            {
+                auto found = mPending.find(&*it);
+                if(found != mPending.end() && found->second != index)
+                    detached.push_back(found->second);
+            }
+            
+            if(it != range.end())
+            {
+                detached.clear();
+                for(std::size_t i = 0; i < mEntries.size(); i++)
+                    if(mEntries[i].inTree && !mEntries[i].detachedWith && isAncestor(child, *mEntries[i].element))
+                        detached.push_back(i);
+            }
+            
+            for(auto i : detached)
+                mEntries[i].detachedWith = &child;
+            if(!detached.empty())
+            {
+                auto& entries = mDetachedBy[&child];
+                entries.insert(entries.end(), detached.begin(), detached.end());
+            }
+        }
+        
+        virtual void onRenamed(elements::BasicElement& element, const std::string& oldName) override
+        {
+            auto& entry = touch(element, true, &oldName);
+            entry.name = element.name();
+        }
+        
+        virtual void onSpecificChanged(elements::BasicElement& element) override
+        {
+            touch(element, true).propertiesChanged = true;
+        }
+    
+    private:
+        /// @brief Everything needed to compute an element's net change without touching it: it may be deleted by then.
+        struct Entry
+        {
+            elements::BasicElement* element;
+            bool wasInTree;                   // The state at the first change of the batch
+            elements::BasicElement* oldParent;
+            std::string oldName;
+            bool inTree;                      // The state after the latest change
+            elements::BasicElement* parent;
+            std::string name;
+            bool repositioned;
+            bool propertiesChanged;
+            elements::BasicElement* detachedWith; // The removed ancestor that took the element out of the tree
+        };
+        
+        static bool isAncestor(const elements::BasicElement& ancestor, const elements::BasicElement& elem)
+        {
+            for(auto parent = elem.parent(); parent; parent = parent->parent())
+                if(parent == &ancestor)
+                    return true;
+            return false;
+        }
+        
+        /// @brief Gets the element's entry, creating it with the element's current state on its first change.
+        /// @param inTree Whether the element is in the tree right now
+        /// @param oldName The element's name before the change, if it's a rename
+        Entry& touch(elements::BasicElement& elem, bool inTree, const std::string* oldName = nullptr)
+        {
+            auto found = mPending.find(&elem);
+            if(found != mPending.end())
+                return mEntries[found->second];
+            
+            mPending.emplace(&elem, mEntries.size());
+            auto name = oldName ? *oldName : elem.name();
+            mEntries.push_back({ &elem, inTree, elem.parent(), name, inTree, elem.parent(), name, false, false, nullptr });
+            return mEntries.back();
+        }
+        
+        /// @brief Checks whether an ancestor of an element in the tree was added in this batch, reporting it already.
+        bool addedWithAncestor(const elements::BasicElement& elem) const
+        {
+            for(auto parent = elem.parent(); parent; parent = parent->parent())
+            {
+                auto found = mPending.find(parent);
+                if(found == mPending.end())
+                    continue;
+                
+                auto& entry = mEntries[found->second];
+                if(!entry.wasInTree && entry.inTree)
+                    return true;
+            }
+            return false;
+        }
+        
+        void collect(const Entry& entry, std::vector<Change>& changes) const
+        {
+            using Kind = Change::Kind;
+            auto inTree = entry.inTree && !entry.detachedWith;
+            
+            if(!entry.wasInTree)
+            {
+                if(inTree && !addedWithAncestor(*entry.element))
+                    changes.push_back({ Kind::Added, entry.element, entry.parent, nullptr, std::string() });
+                return;
+            }
+            
+            if(!inTree)
+            {
+                // A descendant of a removed subtree is only reported if it left its place before
+                if(!entry.detachedWith || entry.repositioned)
+                    changes.push_back({ Kind::Removed, entry.element, entry.oldParent, nullptr, std::string() });
+                return;
+            }
+            
+            // Everything below an added subtree is new anyway
+            if(addedWithAncestor(*entry.element))
+                return;
+            
+            if(entry.repositioned)
+                changes.push_back({ Kind::Moved, entry.element, entry.parent, entry.oldParent, std::string() });
+            if(entry.name != entry.oldName)
+                changes.push_back({ Kind::Renamed, entry.element, nullptr, nullptr, entry.oldName });
+            if(entry.propertiesChanged)
+                changes.push_back({ Kind::PropertiesChanged, entry.element, nullptr, nullptr, std::string() });
+        }
+        
+        elements::BasicElement* mRoot;
+        std::vector<Entry> mEntries; // In the order of their first change
+        std::unordered_map<const elements::BasicElement*, std::size_t> mPending;
+        std::unordered_map<const elements::BasicElement*, std::vector<std::size_t>> mDetachedBy; // Entries per removed subtree
+        std::vector<ChangeListener*> mListeners;
+    };
+}
@@ -7,11 +7,471 @@
 //
 
 #pragma once
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/arena.h"
+#include "../common/symboltable.h"
+#include "../elements/elements.h"
+#include "../elements/handletable.h"
+#include "../elements/intervallabels.h"
+#include "../elements/kindindex.h"
+#include "../elements/lcaindex.h"
+#include "../elements/prefixindex.h"
+#include "../elements/qualifiednameindex.h"
+#include "../elements/referencegraph.h"
+#include "../elements/resolver.h"
+#include "../elements/treediff.h"
+#include "../elements/treemerge.h"
+#include "changefeed.h"
+#include "snapshot.h"
+#include "undolog.h"
 
 namespace vcoder::model
 {
+    /// @brief An open model: owns its element tree, the arena the elements live in, its interned names and indexes.
+    /// @remarks Indexes are built on first use and kept up to date from then on. Every element of the tree comes from the
+    ///          document's arena, so closing it frees the whole tree in O(arena blocks) instead of deleting elements
+    ///          one by one. Elements added to the tree must therefore be created with make().
+    ///          Edits are recorded for undo and redo: elements must be taken out of the tree with remove() rather than
+    ///          deleted, so that the history can bring them back.
     class Document
     {
+    public:
+        Document()
+        : mRoot(nullptr)
+        {
+            mHistory.setWillDelete([this](elements::BasicElement& elem) { forget(elem); });
+        }
+        
+        Document(const Document&) = delete;
+        
+        ~Document()
+        {
+            close();
+        }
+        
+        /// @brief Starts a new document with an empty tree, closing the current one.
+        void create()
+        {
+            close();
+            mSymbols = std::make_unique<common::SymbolTable>();
+            mRoot = make<elements::Root>();
+            mHistory.attach(*mRoot);
+        }
+        
+        /// @brief Loads a document from a file, closing the current one.
+        /// @param path The path of the JSON model
+        /// @remarks Throws std::runtime_error if the file can't be read or doesn't hold a model.
+        void load(const std::string& path)
+        {
+            std::ifstream file(path);
+            if(!file)
+                throw std::runtime_error("Can't open " + path);
+            load(file);
+        }
+        
+        /// @brief Loads a document from a stream, closing the current one.
+        /// @param stream The stream holding the JSON model
+        /// @remarks Throws std::runtime_error if the stream doesn't hold a model.
+        void load(std::istream& stream)
+        {
+            close();
+            auto data = elements::BasicElement::SerializationFormat::parse(stream);
+            
+            common::ArenaScope scope(&mArena);
+            auto root = elements::BasicElement::deserialize(data);
+            if(!root)
+            {
+                mArena.release();
+                throw std::runtime_error("Not a vCoder model");
+            }
+            
+            mSymbols = std::make_unique<common::SymbolTable>();
+            mRoot = root;
+            mHistory.attach(*mRoot);
+        }
+        
+        /// @brief Saves the document to a file.
+        /// @param path The path to write the JSON model to
+        /// @remarks Throws std::runtime_error if no document is open or the file can't be written.
+        void save(const std::string& path) const
+        {
+            std::ofstream file(path);
+            if(!file)
+                throw std::runtime_error("Can't write " + path);
+            save(file);
+        }
+        
+        /// @brief Saves the document to a stream.
+        /// @param stream The stream to write the JSON model to
+        /// @remarks Throws std::runtime_error if no document is open.
+        void save(std::ostream& stream) const
+        {
+            if(!mRoot)
+                throw std::runtime_error("No document is open");
+            stream << mRoot->getSerializable()->serialize().dump(4) << '\n';
+        }
+        
+        /// @brief Closes the document: indexes are dropped and the tree is freed along with the arena.
+        void close()
+        {
+            // The history, versions, feed and indexes unregister from the root, so they go first. Detached subtrees
+            // the history keeps live in the arena as well
+            mHistory.detach(false);
+            mVersions.reset();
+            mChanges.reset();
+            mReferences.reset();
+            mHandles.reset();
+            mResolver.reset();
+            mPrefixes.reset();
+            mLca.reset();
+            mKinds.reset();
+            mLabels.reset();
+            mQualifiedNames.reset();
+            mSymbols.reset();
+            
+            mRoot = nullptr;
+            mArena.release();
+        }
+        
+        /// @brief Checks whether a document is open.
+        /// @return Whether there's a tree
+        bool isOpen() const
+        {
+            return mRoot != nullptr;
+        }
+        
+        /// @brief Creates an element in the document's arena, ready to be added to the tree.
+        /// @tparam T The element class
+        /// @param args The constructor's arguments
+        /// @return The element: owned by its parent once added, by the document until then
+        template<class T, class... Args>
+        T* make(Args&&... args)
+        {
+            common::ArenaScope scope(&mArena);
+            return new T(std::forward<Args>(args)...);
+        }
+        
+        /// @brief Takes an element out of the tree without deleting it, so that undo can put it back.
+        /// @param elem The element: the history owns it from then on, and deletes it once it can't be brought back
+        void remove(elements::BasicElement& elem)
+        {
+            if(auto parent = elem.parent())
+                parent->removeChild(&elem);
+        }
+        
+        /// @brief Changes an element's properties, recording their previous values for undo.
+        /// @param elem The element
+        /// @param fn The callback doing the change: must accept one argument of type BasicElement&
+        template<class F>
+        void modify(elements::BasicElement& elem, const F& fn)
+        {
+            mHistory.recordProperties(elem);
+            fn(elem);
+            elem.specificChanged();
+        }
+        
+        /// @brief Applies an edit script from diffTrees() to the tree as one undo step.
+        /// @param script The script: must have been computed from a tree equal to this one
+        /// @remarks Throws a std::runtime_error if the tree doesn't match, leaving it untouched. Deleted subtrees go to
+        ///          the history like removed ones.
+        void patch(const elements::EditScript& script)
+        {
+            auto edits = transaction();
+            
+            // Properties are only recorded on request: the old elements the script changes are found by pre-order id
+            std::vector<std::uint32_t> changed;
+            for(auto& edit : script.edits)
+                if(edit.kind == elements::Edit::Kind::SetProperties && edit.node < script.baseSize)
+                    changed.push_back(edit.node);
+            
+            if(!changed.empty() && mRoot->treeHash() == script.baseHash)
+            {
+                std::sort(changed.begin(), changed.end());
+                std::uint32_t id = 0;
+                auto next = changed.begin();
+                for(auto& elem : elements::preOrder(*mRoot))
+                {
+                    for(; next != changed.end() && *next == id; next++)
+                        mHistory.recordProperties(elem);
+                    if(next == changed.end())
+                        break;
+                    id++;
+                }
+            }
+            
+            common::ArenaScope scope(&mArena);
+            elements::applyPatch(*mRoot, script);
+            edits.commit();
+        }
+        
+        /// @brief Merges another branch of the model into the tree as one undo step.
+        /// @param base The version both branches started from
+        /// @param theirs The other branch: left untouched
+        /// @return The conflicts: the tree keeps its own side of each
+        /// @remarks Subtrees the other branch deleted go to the history like removed ones.
+        std::vector<elements::MergeConflict> merge(elements::BasicElement& base, elements::BasicElement& theirs)
+        {
+            auto edits = transaction();
+            common::ArenaScope scope(&mArena);
+            auto result = elements::mergeTrees(base, *mRoot, theirs, [this](elements::BasicElement& elem) {
+                mHistory.recordProperties(elem);
+            });
+            edits.commit();
+            return std::move(result.conflicts);
+        }
+        
+        /// @brief Groups edits into one undo step until committed: the edits are rolled back if it never is.
+        class Transaction
+        {
+        public:
+            explicit Transaction(Document& document)
+            : mDocument(&document)
+            {
+                mDocument->mHistory.begin();
+            }
+            
+            Transaction(Transaction&& other)
+            : mDocument(other.mDocument)
+            {
+                other.mDocument = nullptr;
+            }
+            
+            ~Transaction()
+            {
+                rollback();
+            }
+            
+            /// @brief Keeps the edits made since the transaction started, publishing them if it was the outermost one.
+            void commit()
+            {
+                if(!mDocument)
+                    return;
+                
+                mDocument->mHistory.commit();
+                mDocument->publish();
+                mDocument = nullptr;
+            }
+            
+            /// @brief Reverts the edits made since the transaction started.
+            void rollback()
+            {
+                if(!mDocument)
+                    return;
+                
+                mDocument->mHistory.rollback();
+                mDocument->publish();
+                mDocument = nullptr;
+            }
+        
+        private:
+            Document* mDocument;
+        };
+        
+        /// @brief Starts a transaction: transactions nest, and only the outermost one becomes an undo step.
+        /// @return The transaction: rolled back when destroyed uncommitted
+        Transaction transaction()
+        {
+            return Transaction(*this);
+        }
+        
+        /// @brief Reverts the last undo step.
+        /// @return Whether there was one: never while a transaction is open
+        bool undo()
+        {
+            auto undone = mHistory.undo();
+            publish();
+            return undone;
+        }
+        
+        /// @brief Reapplies the last reverted undo step.
+        /// @return Whether there was one: never while a transaction is open
+        bool redo()
+        {
+            auto redone = mHistory.redo();
+            publish();
+            return redone;
+        }
+        
+        /// @brief Gets the version store readers on other threads take snapshots from, publishing a first version on
+        ///        first use.
+        /// @return The store: only valid while the document is open
+        /// @remarks Must be called from the thread editing the document. Committed transactions, undo and redo publish
+        ///          a new version; other edits are published by the next call to publish().
+        VersionStore& versions()
+        {
+            return attached(mVersions);
+        }
+        
+        /// @brief Gets the table of element handles, creating it on first use.
+        /// @return The table: only valid while the document is open
+        /// @remarks Handles stay valid while their elements are out of the tree, as undo may bring them back: they're
+        ///          released, and their references() removed, when the history deletes the elements.
+        elements::HandleTable& handles()
+        {
+            if(!mHandles)
+                mHandles = std::make_unique<elements::HandleTable>();
+            return *mHandles;
+        }
+        
+        /// @brief Gets the graph of references between elements, keyed by their handles(), creating it on first use.
+        /// @return The graph: only valid while the document is open
+        elements::ReferenceGraph& references()
+        {
+            if(!mReferences)
+                mReferences = std::make_unique<elements::ReferenceGraph>();
+            return *mReferences;
+        }
+        
+        /// @brief Gets the change feed, collecting changes from first use on.
+        /// @return The feed: only valid while the document is open
+        /// @remarks Batches are delivered when edits are published: see versions().
+        ChangeFeed& changes()
+        {
+            return attached(mChanges);
+        }
+        
+        /// @brief Publishes the edits made since the last call, unless a transaction is open: a new version goes to
+        ///        the version store and a batch of changes to the change feed.
+        void publish()
+        {
+            if(mHistory.inTransaction())
+                return;
+            
+            if(mVersions)
+                mVersions->publish();
+            if(mChanges)
+                mChanges->flush();
+        }
+        
+        /// @brief Gets the edit history.
+        /// @return The history: see UndoLog
+        UndoLog& history()
+        {
+            return mHistory;
+        }
+        
+        /// @brief Gets the tree's root.
+        /// @return The root or nullptr if no document is open
+        elements::BasicElement* root() const
+        {
+            return mRoot;
+        }
+        
+        /// @brief Gets the arena the document's elements live in.
+        /// @return The arena
+        common::Arena& arena()
+        {
+            return mArena;
+        }
+        
+        /// @brief Gets the table the document's indexes intern names in.
+        /// @return The symbol table: only valid while the document is open
+        common::SymbolTable& symbols()
+        {
+            return *mSymbols;
+        }
+        
+        /// @brief Gets the qualified name index, building it on first use.
+        /// @return The index: only valid while the document is open
+        elements::QualifiedNameIndex& qualifiedNames()
+        {
+            return attached(mQualifiedNames);
+        }
+        
+        /// @brief Gets the interval labels, building them on first use.
+        /// @return The labeler: only valid while the document is open
+        elements::IntervalLabeler& labels()
+        {
+            return attached(mLabels);
+        }
+        
+        /// @brief Gets the kind index, building it (and the interval labels it relies on) on first use.
+        /// @return The index: only valid while the document is open
+        elements::KindIndex& kinds()
+        {
+            return attached(mKinds, labels());
+        }
+        
+        /// @brief Gets the lowest common ancestor index, building it on first use.
+        /// @return The index: only valid while the document is open
+        elements::LcaIndex& lca()
+        {
+            return attached(mLca);
+        }
+        
+        /// @brief Gets the prefix index, building it on first use.
+        /// @return The index: only valid while the document is open
+        elements::PrefixIndex& prefixes()
+        {
+            if(!mPrefixes)
+            {
+                mPrefixes = std::make_unique<elements::PrefixIndex>(*mSymbols);
+                mPrefixes->attach(*mRoot);
+            }
+            return *mPrefixes;
+        }
+        
+        /// @brief Gets the scoped name resolver, attaching it on first use: its memo fills up as names get resolved.
+        /// @return The resolver: only valid while the document is open
+        elements::ScopeResolver& resolver()
+        {
+            if(!mResolver)
+            {
+                mResolver = std::make_unique<elements::ScopeResolver>(*mSymbols);
+                mResolver->attach(*mRoot);
+            }
+            return *mResolver;
+        }
+    
+    private:
+        /// @brief Drops an element the history is about to delete from the structures that don't observe the tree.
+        void forget(elements::BasicElement& elem)
+        {
+            if(!mHandles)
+                return;
+            
+            auto handle = mHandles->find(elem);
+            if(handle == elements::kNoHandle)
+                return;
+            
+            if(mReferences)
+                mReferences->removeElement(handle);
+            mHandles->release(elem);
+        }
+        
+        template<class Index, class... Args>
+        Index& attached(std::unique_ptr<Index>& index, Args&... args)
+        {
+            if(!index)
+            {
+                index = std::make_unique<Index>();
+                index->attach(*mRoot, args...);
+            }
+            return *index;
+        }
         
+        // The arena is declared first so that it's destroyed last
+        common::Arena mArena;
+        elements::BasicElement* mRoot;
+        std::unique_ptr<common::SymbolTable> mSymbols;
+        UndoLog mHistory;
+        std::unique_ptr<VersionStore> mVersions;
+        std::unique_ptr<ChangeFeed> mChanges;
+        std::unique_ptr<elements::HandleTable> mHandles;
+        std::unique_ptr<elements::ReferenceGraph> mReferences;
+        std::unique_ptr<elements::QualifiedNameIndex> mQualifiedNames;
+        std::unique_ptr<elements::IntervalLabeler> mLabels;
+        std::unique_ptr<elements::KindIndex> mKinds;
+        std::unique_ptr<elements::LcaIndex> mLca;
+        std::unique_ptr<elements::PrefixIndex> mPrefixes;
+        std::unique_ptr<elements::ScopeResolver> mResolver;
     };
 }
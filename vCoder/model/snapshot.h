@@ -0,0 +1,257 @@
+//
+//  snapshot.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../common/cxbinary.h"
+#include "../common/epoch.h"
+#include "../elements/elements.h"
+
+namespace vcoder::model
+{
+    /// @brief An immutable copy of an element, shared between every version where its subtree didn't change.
+    /// @remarks Two versions hold the same node exactly when the subtree is the same in both, so comparing node
+    ///          pointers tells readers what changed in between.
+    class SnapshotNode
+    {
+    public:
+        using Ptr = std::shared_ptr<const SnapshotNode>;
+        
+        /// @brief Gets the kind of the element.
+        /// @return The kind
+        elements::ElementKind kind() const
+        {
+            return mKind;
+        }
+        
+        /// @brief Gets the name of the element.
+        /// @return The name
+        const std::string& name() const
+        {
+            return mName;
+        }
+        
+        /// @brief Gets the CX properties of the element.
+        /// @return The properties in CX binary: CX::DeserializeBinary() restores them into an element of the same kind
+        const std::string& properties() const
+        {
+            return mProperties;
+        }
+        
+        /// @brief Gets the children of the element.
+        /// @return The children, in order
+        const std::vector<Ptr>& children() const
+        {
+            return mChildren;
+        }
+        
+        /// @brief Finds a child by name.
+        /// @param name The name of the child
+        /// @return The first child with that name or nullptr
+        const SnapshotNode* findChild(std::string_view name) const
+        {
+            for(auto& child : mChildren)
+                if(child->mName == name)
+                    return child.get();
+            return nullptr;
+        }
+    
+    private:
+        friend class VersionStore;
+        
+        elements::ElementKind mKind;
+        std::string mName;
+        std::string mProperties;
+        std::vector<Ptr> mChildren;
+    };
+    
+    /// @brief Publishes versions of a tree for readers on other threads: each one is an immutable, consistent copy.
+    /// @remarks Only the writer thread (the one mutating the tree) may attach, publish or detach. Publishing copies the
+    ///          paths from the edited elements up to the root and shares every other node with the previous version, so
+    ///          it costs O(edited paths), and swaps the version in atomically. Readers take snapshots from any thread
+    ///          without locking; a replaced version is deleted by epoch-based reclamation once no snapshot holds it.
+    class VersionStore : public elements::TreeObserver
+    {
+        struct Version;
+    
+    public:
+        /// @brief A pinned version: the tree it shows stays valid and unchanged until the snapshot is destroyed.
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&&) = default;
+            
+            /// @brief Gets the root of the version.
+            /// @return The root
+            const SnapshotNode& root() const
+            {
+                return *mVersion->root;
+            }
+            
+            /// @brief Gets the number of the version: versions are numbered in publishing order.
+            /// @return The version number
+            std::uint64_t version() const
+            {
+                return mVersion->number;
+            }
+        
+        private:
+            friend class VersionStore;
+            
+            Snapshot(common::EpochDomain& epochs, const std::atomic<const Version*>& current)
+            : mGuard(epochs), mVersion(current.load()) {}
+            
+            common::EpochDomain::Guard mGuard;
+            const Version* mVersion;
+        };
+        
+        VersionStore()
+        : mRoot(nullptr), mCurrent(nullptr), mNumber(0) {}
+        
+        VersionStore(const VersionStore&) = delete;
+        
+        /// @brief Destroys the store: no snapshot may be alive anymore.
+        ~VersionStore()
+        {
+            detach();
+        }
+        
+        /// @brief Starts tracking a tree and publishes its first version.
+        /// @param root The tree's topmost element
+        void attach(elements::BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+            publish();
+        }
+        
+        /// @brief Stops tracking the tree: no snapshot may be alive anymore.
+        void detach()
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            delete mCurrent.exchange(nullptr);
+            mEpochs.reclaim();
+            mNodes.clear();
+            mDirty.clear();
+            mRoot = nullptr;
+        }
+        
+        /// @brief Publishes the edits made since the last version, if any.
+        void publish()
+        {
+            if(!mRoot || (mCurrent.load() && mDirty.empty()))
+                return;
+            
+            auto version = new Version { build(*mRoot), ++mNumber };
+            mDirty.clear();
+            
+            // Readers pinned from now on can only load the new version
+            if(auto previous = mCurrent.exchange(version))
+                mEpochs.retire(previous);
+        }
+        
+        /// @brief Pins the current version: safe to call from any thread.
+        /// @return The snapshot
+        /// @remarks At most common::EpochDomain::kSlots snapshots can be alive at once: taking one more waits until
+        ///          another is destroyed, so a thread must never hold that many itself.
+        Snapshot snapshot() const
+        {
+            return Snapshot(mEpochs, mCurrent);
+        }
+        
+        /// @brief Gets the number of replaced versions still held by snapshots.
+        /// @return The version count
+        std::size_t pendingVersions() const
+        {
+            return mEpochs.pending();
+        }
+        
+        virtual void onChildAdded(elements::BasicElement& parent, elements::BasicElement&) override
+        {
+            markDirty(&parent);
+        }
+        
+        virtual void onChildRemoving(elements::BasicElement& parent, elements::BasicElement& child) override
+        {
+            markDirty(&parent);
+            
+            // The subtree may be deleted from now on: its nodes are rebuilt if it's ever added back
+            forget(child);
+        }
+        
+        virtual void onRenamed(elements::BasicElement& element, const std::string&) override
+        {
+            markDirty(&element);
+        }
+        
+        virtual void onSpecificChanged(elements::BasicElement& element) override
+        {
+            markDirty(&element);
+        }
+    
+    private:
+        struct Version
+        {
+            SnapshotNode::Ptr root;
+            std::uint64_t number;
+        };
+        
+        /// @brief Marks an element and its ancestors for copying: stops at the first one already marked, as its
+        ///        ancestors are too.
+        void markDirty(const elements::BasicElement* elem)
+        {
+            while(elem && mDirty.insert(elem).second)
+                elem = elem->parent();
+        }
+        
+        void forget(elements::BasicElement& elem)
+        {
+            mNodes.erase(&elem);
+            mDirty.erase(&elem);
+            elem.forAllChildren([this](elements::BasicElement& child) { forget(child); });
+        }
+        
+        SnapshotNode::Ptr build(elements::BasicElement& elem)
+        {
+            if(!mDirty.count(&elem))
+            {
+                auto cached = mNodes.find(&elem);
+                if(cached != mNodes.end())
+                    return cached->second;
+            }
+            
+            auto node = std::make_shared<SnapshotNode>();
+            node->mKind = elem.kind();
+            node->mName = elem.name();
+            node->mProperties = elements::visitElement(elem, [](auto& concrete) { return CX::SerializeBinary(concrete); });
+            node->mChildren.reserve(elem.childCount());
+            elem.forAllChildren([this, &node](elements::BasicElement& child) { node->mChildren.push_back(build(child)); });
+            
+            return mNodes[&elem] = std::move(node);
+        }
+        
+        elements::BasicElement* mRoot;
+        std::atomic<const Version*> mCurrent;
+        mutable common::EpochDomain mEpochs;
+        std::unordered_map<const elements::BasicElement*, SnapshotNode::Ptr> mNodes; // The last published node of each element
+        std::unordered_set<const elements::BasicElement*> mDirty;                   // The elements to copy at the next publish
+        std::uint64_t mNumber;
+    };
+    
+    using Snapshot = VersionStore::Snapshot;
+}
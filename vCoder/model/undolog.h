@@ -0,0 +1,412 @@
+//
+//  undolog.h
+//  vCoder
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/cxbinary.h"
+#include "../elements/elements.h"
+
+namespace vcoder::model
+{
+    /// @brief Records edits of an element tree as compact inverse operations, for grouped undo and redo.
+    /// @remarks Each edit is logged as one operation: an added, removed or renamed element, or the previous CX
+    ///          properties of an element as binary. Operations are grouped into transactions, and undoing or redoing
+    ///          one costs O(its operations). Detached subtrees aren't copied: the log keeps them by pointer, counting
+    ///          references, and deletes them once no operation refers to them anymore. The oldest transactions are
+    ///          dropped when the log grows past its memory limit.
+    ///          Only elements detached with removeChild() can be brought back: deleting an element outright can't be
+    ///          undone, and it must not happen while the log refers to it.
+    class UndoLog : public elements::TreeObserver
+    {
+    public:
+        UndoLog()
+        : mRoot(nullptr), mDepth(0), mReplaying(false), mApplied(0), mAppliedOps(0), mBytes(0), mLimit(64 << 20) {}
+        
+        UndoLog(const UndoLog&) = delete;
+        
+        ~UndoLog()
+        {
+            detach();
+        }
+        
+        /// @brief Starts recording the edits of a tree.
+        /// @param root The tree's topmost element
+        void attach(elements::BasicElement& root)
+        {
+            detach();
+            mRoot = &root;
+            mRoot->addObserver(this);
+        }
+        
+        /// @brief Stops recording and drops the whole history.
+        /// @param freeDetached Whether to delete the detached subtrees only the log refers to: pass false when their
+        ///        memory is about to be released some other way, e.g. along with an arena
+        void detach(bool freeDetached = true)
+        {
+            if(mRoot)
+                mRoot->removeObserver(this);
+            
+            if(freeDetached)
+            {
+                // Only the roots of detached subtrees get deleted, collected first as they take their descendants along
+                std::vector<elements::BasicElement*> detached;
+                for(auto& ref : mRefs)
+                    if(!ref.first->parent() && ref.first != mRoot)
+                        detached.push_back(ref.first);
+                for(auto elem : detached)
+                    destroy(elem);
+            }
+            
+            mOps.clear();
+            mGroups.clear();
+            mStarts.clear();
+            mRefs.clear();
+            mRoot = nullptr;
+            mDepth = 0;
+            mApplied = 0;
+            mAppliedOps = 0;
+            mBytes = 0;
+        }
+        
+        /// @brief Opens a transaction: edits until the matching commit() are undone and redone as one.
+        /// @remarks Transactions nest: only the outermost one forms an undo step.
+        void begin()
+        {
+            mStarts.push_back(openEnd());
+            mDepth++;
+        }
+        
+        /// @brief Closes the innermost transaction, keeping its edits.
+        void commit()
+        {
+            if(!mDepth)
+                return;
+            
+            mStarts.pop_back();
+            if(--mDepth == 0)
+                closeGroup();
+        }
+        
+        /// @brief Closes the innermost transaction, reverting its edits.
+        void rollback()
+        {
+            if(!mDepth)
+                return;
+            
+            auto start = mStarts.back();
+            mStarts.pop_back();
+            mDepth--;
+            
+            mReplaying = true;
+            for(; openEnd() > start; mOps.pop_back())
+            {
+                revert(mOps.back());
+                forget(mOps.back());
+            }
+            mReplaying = false;
+        }
+        
+        /// @brief Snapshots an element's CX properties: call it right before changing them.
+        /// @param elem The element about to change
+        void recordProperties(elements::BasicElement& elem)
+        {
+            if(mRoot && !mReplaying && elem.treeRoot() == mRoot)
+                record({ OpKind::Properties, &elem, nullptr, nullptr, snapshot(elem) });
+        }
+        
+        /// @brief Reverts the last transaction.
+        /// @return Whether there was one to revert: never while a transaction is open
+        bool undo()
+        {
+            if(!canUndo())
+                return false;
+            
+            auto count = mGroups[mApplied - 1];
+            mReplaying = true;
+            for(auto i = mAppliedOps; i > mAppliedOps - count; i--)
+                revert(mOps[i - 1]);
+            mReplaying = false;
+            
+            mApplied--;
+            mAppliedOps -= count;
+            return true;
+        }
+        
+        /// @brief Reapplies the last reverted transaction.
+        /// @return Whether there was one to reapply: never while a transaction is open
+        bool redo()
+        {
+            if(!canRedo())
+                return false;
+            
+            auto count = mGroups[mApplied];
+            mReplaying = true;
+            for(auto i = mAppliedOps; i < mAppliedOps + count; i++)
+                apply(mOps[i]);
+            mReplaying = false;
+            
+            mApplied++;
+            mAppliedOps += count;
+            return true;
+        }
+        
+        /// @brief Checks whether undo() would do something.
+        /// @return Whether there's a transaction to revert
+        bool canUndo() const
+        {
+            return !mDepth && mApplied > 0;
+        }
+        
+        /// @brief Checks whether redo() would do something.
+        /// @return Whether there's a transaction to reapply
+        bool canRedo() const
+        {
+            return !mDepth && mApplied < mGroups.size();
+        }
+        
+        /// @brief Checks whether a transaction is open.
+        /// @return Whether edits are currently grouped
+        bool inTransaction() const
+        {
+            return mDepth > 0;
+        }
+        
+        /// @brief Sets a callback invoked for every element of a detached subtree right before the log deletes it, e.g.
+        ///        to drop the element from indexes that don't observe the tree.
+        /// @param fn The callback: must accept one argument of type BasicElement&, or be empty
+        void setWillDelete(std::function<void(elements::BasicElement&)> fn)
+        {
+            mWillDelete = std::move(fn);
+        }
+        
+        /// @brief Sets how much memory the history may take before the oldest transactions get dropped.
+        /// @param bytes The limit, approximate: the last transaction is always kept, and nothing is dropped while there
+        ///        are transactions to redo
+        void setLimit(std::size_t bytes)
+        {
+            mLimit = bytes;
+            trim();
+        }
+        
+        /// @brief Gets the approximate memory taken by the history.
+        /// @return The byte count, not counting the detached subtrees it keeps
+        std::size_t bytes() const
+        {
+            return mBytes;
+        }
+        
+        virtual void onChildAdded(elements::BasicElement& parent, elements::BasicElement& child) override
+        {
+            if(!mReplaying)
+                record({ OpKind::Add, &child, &parent, child.nextSibling(), std::string() });
+        }
+        
+        virtual void onChildRemoving(elements::BasicElement& parent, elements::BasicElement& child) override
+        {
+            if(!mReplaying)
+                record({ OpKind::Remove, &child, &parent, child.nextSibling(), std::string() });
+        }
+        
+        virtual void onRenamed(elements::BasicElement& element, const std::string& oldName) override
+        {
+            if(!mReplaying)
+                record({ OpKind::Rename, &element, nullptr, nullptr, oldName });
+        }
+    
+    private:
+        enum class OpKind : std::uint8_t
+        {
+            Add,
+            Remove,
+            Rename,
+            Properties
+        };
+        
+        /// @brief One edit: data holds the other name or CX properties, swapped with the current ones when replayed.
+        struct Op
+        {
+            OpKind kind;
+            elements::BasicElement* elem;
+            elements::BasicElement* parent;
+            elements::BasicElement* before; // The next sibling at the time: puts the element back at the same position
+            std::string data;
+        };
+        
+        static std::string snapshot(elements::BasicElement& elem)
+        {
+            return elements::visitElement(elem, [](auto& concrete) { return CX::SerializeBinary(concrete); });
+        }
+        
+        static void swapProperties(Op& op)
+        {
+            auto current = snapshot(*op.elem);
+            elements::visitElement(*op.elem, [&op](auto& concrete) { CX::DeserializeBinary(op.data, concrete); });
+            op.data = std::move(current);
+            op.elem->specificChanged();
+        }
+        
+        static void swapName(Op& op)
+        {
+            auto current = op.elem->name();
+            op.elem->setName(op.data);
+            op.data = std::move(current);
+        }
+        
+        static std::size_t sizeOf(const Op& op)
+        {
+            return sizeof(Op) + op.data.capacity();
+        }
+        
+        void apply(Op& op)
+        {
+            switch(op.kind)
+            {
+                case OpKind::Add:
+                    op.parent->insertChild(op.elem, op.before);
+                    break;
+                case OpKind::Remove:
+                    op.parent->removeChild(op.elem);
+                    break;
+                case OpKind::Rename:
+                    swapName(op);
+                    break;
+                case OpKind::Properties:
+                    swapProperties(op);
+                    break;
+            }
+        }
+        
+        void revert(Op& op)
+        {
+            switch(op.kind)
+            {
+                case OpKind::Add:
+                    op.parent->removeChild(op.elem);
+                    break;
+                case OpKind::Remove:
+                    op.parent->insertChild(op.elem, op.before);
+                    break;
+                case OpKind::Rename:
+                    swapName(op);
+                    break;
+                case OpKind::Properties:
+                    swapProperties(op);
+                    break;
+            }
+        }
+        
+        void record(Op&& op)
+        {
+            // A new edit makes the reverted transactions unreachable: they're dropped newest first, as they were reverted
+            if(mGroups.size() > mApplied)
+            {
+                for(; mOps.size() > mAppliedOps; mOps.pop_back())
+                    forget(mOps.back());
+                mGroups.resize(mApplied);
+            }
+            
+            for(auto elem : { op.elem, op.parent, op.before })
+                if(elem)
+                    mRefs[elem]++;
+            
+            mBytes += sizeOf(op);
+            mOps.push_back(std::move(op));
+            
+            // Edits outside of a transaction are undone one by one
+            if(!mDepth)
+                closeGroup();
+        }
+        
+        /// @brief Gets where the open transaction's operations end: right after the applied ones, as recording drops
+        ///        the reverted ones first.
+        std::size_t openEnd() const
+        {
+            return mGroups.size() > mApplied ? mAppliedOps : mOps.size();
+        }
+        
+        void closeGroup()
+        {
+            if(openEnd() == mAppliedOps)
+                return;
+            
+            mGroups.push_back(mOps.size() - mAppliedOps);
+            mApplied++;
+            mAppliedOps = mOps.size();
+            trim();
+        }
+        
+        /// @brief Drops an operation's references, deleting the subtrees nothing refers to anymore.
+        void forget(Op& op)
+        {
+            mBytes -= sizeOf(op);
+            release(op);
+        }
+        
+        void release(Op& op)
+        {
+            for(auto elem : { op.elem, op.parent, op.before })
+            {
+                if(!elem)
+                    continue;
+                
+                auto ref = mRefs.find(elem);
+                if(ref == mRefs.end() || --ref->second)
+                    continue;
+                
+                mRefs.erase(ref);
+                if(!elem->parent() && elem != mRoot)
+                    destroy(elem);
+            }
+        }
+        
+        void destroy(elements::BasicElement* elem)
+        {
+            if(mWillDelete)
+                for(auto& desc : elements::preOrder(*elem))
+                    mWillDelete(desc);
+            delete elem;
+        }
+        
+        /// @brief Drops the oldest transactions until the history fits its limit.
+        /// @remarks Waits until nothing can be redone: with every operation applied, a detached element nothing refers
+        ///          to can't have descendants some newer operation refers to.
+        void trim()
+        {
+            while(mBytes > mLimit && mApplied > 1 && mApplied == mGroups.size())
+            {
+                for(auto count = mGroups.front(); count; count--)
+                {
+                    forget(mOps.front());
+                    mOps.pop_front();
+                }
+                
+                mAppliedOps -= mGroups.front();
+                mGroups.pop_front();
+                mApplied--;
+            }
+        }
+        
+        elements::BasicElement* mRoot;
+        std::deque<Op> mOps;                  // Applied transactions, then reverted ones
+        std::deque<std::size_t> mGroups;      // The operation count of each transaction
+        std::vector<std::size_t> mStarts;     // Where each open transaction starts in mOps
+        std::unordered_map<elements::BasicElement*, std::uint32_t> mRefs;
+        std::size_t mDepth;
+        bool mReplaying;
+        std::size_t mApplied;                 // The number of applied transactions: the rest can be redone
+        std::size_t mAppliedOps;              // The number of operations they hold
+        std::size_t mBytes;
+        std::size_t mLimit;
+        std::function<void(elements::BasicElement&)> mWillDelete;
+    };
+}
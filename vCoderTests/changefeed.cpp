@@ -0,0 +1,110 @@
+//
+//  changefeed.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/changefeed.cpp -o changefeed && ./changefeed
+//
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "model/document.h"
+
+using namespace vcoder;
+
+struct Recorder : model::ChangeListener
+{
+    std::vector<model::Change> changes;
+    
+    virtual void onChanges(const std::vector<model::Change>& batch) override
+    {
+        changes.insert(changes.end(), batch.begin(), batch.end());
+    }
+    
+    std::size_t count(model::Change::Kind kind) const
+    {
+        std::size_t result = 0;
+        for(auto& change : changes)
+            result += change.kind == kind;
+        return result;
+    }
+};
+
+/// @brief A touched descendant leaves with its removed ancestor, and comes back with it.
+static void testRemovedWithAncestor()
+{
+    model::Document document;
+    document.create();
+    auto outer = document.make<elements::Namespace>("outer");
+    auto inner = document.make<elements::Function>("inner");
+    outer->addChild(inner);
+    document.root()->addChild(outer);
+    document.publish();
+    
+    Recorder recorder;
+    document.changes().addListener(&recorder);
+    {
+        auto edits = document.transaction();
+        inner->setName("renamed");
+        document.remove(*outer);
+        edits.commit();
+    }
+    assert(recorder.changes.size() == 1 && recorder.changes[0].kind == model::Change::Kind::Removed);
+    assert(recorder.changes[0].element == outer);
+    
+    recorder.changes.clear();
+    {
+        auto edits = document.transaction();
+        inner->setName("again");
+        document.root()->addChild(outer);
+        document.remove(*outer);
+        document.root()->addChild(outer);
+        edits.commit();
+    }
+    assert(recorder.count(model::Change::Kind::Added) == 1 && recorder.changes.size() == 1);
+    document.changes().removeListener(&recorder);
+    document.close();
+}
+
+/// @brief Many removals in one batch: each is reported once.
+static void testLargeBatch()
+{
+    model::Document document;
+    document.create();
+    std::vector<elements::BasicElement*> children;
+    for(int i = 0; i < 40000; i++)
+    {
+        auto child = document.make<elements::Namespace>("n" + std::to_string(i));
+        child->addChild(document.make<elements::Type>("t"));
+        document.root()->addChild(child);
+        children.push_back(child);
+    }
+    document.publish();
+    
+    Recorder recorder;
+    document.changes().addListener(&recorder);
+    {
+        auto edits = document.transaction();
+        for(auto child : children)
+        {
+            child->firstChild()->setName("u");
+            document.remove(*child);
+        }
+        edits.commit();
+    }
+    assert(recorder.changes.size() == children.size());
+    assert(recorder.count(model::Change::Kind::Removed) == children.size());
+    document.changes().removeListener(&recorder);
+    document.close();
+}
+
+int main()
+{
+    testRemovedWithAncestor();
+    testLargeBatch();
+    std::puts("changefeed: ok");
+}
@@ -0,0 +1,80 @@
+//
+//  childindex.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/childindex.cpp -o childindex && ./childindex
+//
+
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "elements/elements.h"
+
+using namespace vcoder;
+
+/// @brief Builds a namespace with enough children for it to get a child index.
+static elements::Namespace* makeWide(const std::string& name, int children)
+{
+    auto ns = new elements::Namespace(name);
+    for(int i = 0; i < children; i++)
+        ns->addChild(new elements::Function(name + "_" + std::to_string(i)));
+    return ns;
+}
+
+/// @brief Lookups in wide scopes keep working across renames, removals and a serialization round trip.
+static void testWideScopeLookups()
+{
+    elements::Root root;
+    auto ns = makeWide("ns", 100);
+    root.addChild(ns);
+    
+    assert(root.resolve("ns::ns_42"));
+    ns->findChild("ns_42")->setName("renamed");
+    assert(!ns->findChild("ns_42"));
+    assert(ns->findChild("renamed"));
+    
+    auto removed = ns->findChild("ns_7");
+    ns->removeChild(removed);
+    delete removed;
+    assert(!ns->findChild("ns_7"));
+    
+    auto data = root.getSerializable()->serialize();
+    std::unique_ptr<elements::BasicElement> copy(elements::BasicElement::deserialize(data));
+    assert(copy->resolve("ns::renamed"));
+    assert(copy->resolve("ns::ns_99"));
+    assert(!copy->resolve("ns::ns_42"));
+}
+
+/// @brief Separate trees share no state, so they can be built and searched on different threads at once.
+static void testTreesOnSeparateThreads()
+{
+    auto work = [](const std::string& name) {
+        for(int round = 0; round < 20; round++)
+        {
+            elements::Root root;
+            auto ns = makeWide(name, 500);
+            root.addChild(ns);
+            for(int i = 0; i < 500; i += 7)
+                assert(ns->findChild(name + "_" + std::to_string(i)));
+            assert(!ns->findChild("missing"));
+        }
+    };
+    
+    std::thread first(work, "first");
+    std::thread second(work, "second");
+    first.join();
+    second.join();
+}
+
+int main()
+{
+    testWideScopeLookups();
+    testTreesOnSeparateThreads();
+    std::puts("childindex: ok");
+}
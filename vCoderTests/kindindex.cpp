@@ -0,0 +1,121 @@
+//
+//  kindindex.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/kindindex.cpp -o kindindex && ./kindindex
+//
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "elements/elements.h"
+#include "elements/kindindex.h"
+
+using namespace vcoder;
+
+/// @brief Subtree queries answer from the labels of the labeler the index was attached with.
+static void testSubtreeQuery()
+{
+    elements::Root root;
+    auto outer = new elements::Namespace("outer");
+    outer->addChild(new elements::Function("inner"));
+    root.addChild(outer);
+    root.addChild(new elements::Function("other"));
+    
+    elements::IntervalLabeler labels;
+    labels.attach(root);
+    elements::KindIndex kinds;
+    kinds.attach(root, labels);
+    assert(kinds.count(elements::ElementKind::Function) == 2);
+    assert(kinds.findIn(elements::ElementKind::Function, *outer).size() == 1);
+    kinds.detach();
+}
+
+/// @brief Once the labeler stops maintaining the tree, subtree queries fail instead of answering nothing.
+static void testDetachedLabeler()
+{
+    elements::Root root;
+    root.addChild(new elements::Function("f"));
+    
+    elements::IntervalLabeler labels;
+    labels.attach(root);
+    elements::KindIndex kinds;
+    kinds.attach(root, labels);
+    assert(kinds.findIn(elements::ElementKind::Function, root).size() == 1);
+    
+    labels.detach();
+    auto threw = false;
+    try
+    {
+        kinds.findIn(elements::ElementKind::Function, root);
+    }
+    catch(const std::logic_error&)
+    {
+        threw = true;
+    }
+    assert(threw);
+    kinds.detach();
+}
+
+/// @brief Edits interleaved with subtree queries: the answers match a walk of the subtree, in pre-order.
+static void testEditsBetweenQueries()
+{
+    elements::Root root;
+    elements::IntervalLabeler labels;
+    labels.attach(root);
+    elements::KindIndex kinds;
+    kinds.attach(root, labels);
+    
+    std::mt19937 random(42);
+    std::vector<elements::BasicElement*> all { &root };
+    auto pick = [&]() { return all[random() % all.size()]; };
+    auto kindOf = [&]() { return random() % 2 ? elements::ElementKind::Function : elements::ElementKind::Namespace; };
+    
+    for(int round = 0; round < 3000; round++)
+    {
+        if(random() % 3 || all.size() < 10)
+        {
+            // Adding a small subtree, inserted among its parent's children
+            auto top = new elements::Namespace("n");
+            for(int i = random() % 4; i > 0; i--)
+                top->addChild(new elements::Function("f"));
+            auto parent = pick();
+            parent->insertChild(top, parent->firstChild());
+        }
+        else
+        {
+            auto victim = pick();
+            if(victim != &root)
+                delete victim;
+        }
+        
+        all.clear();
+        for(auto& elem : elements::preOrder(root))
+            all.push_back(&elem);
+        
+        auto kind = kindOf();
+        auto& scope = *pick();
+        std::vector<elements::BasicElement*> expected;
+        for(auto& elem : elements::preOrder(scope))
+            if(elem.kind() == kind)
+                expected.push_back(&elem);
+        assert(kinds.findIn(kind, scope) == expected);
+    }
+    
+    kinds.detach();
+    labels.detach();
+}
+
+int main()
+{
+    testSubtreeQuery();
+    testDetachedLabeler();
+    testEditsBetweenQueries();
+    std::puts("kindindex: ok");
+}
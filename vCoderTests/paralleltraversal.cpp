@@ -0,0 +1,68 @@
+//
+//  paralleltraversal.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/paralleltraversal.cpp -o paralleltraversal && ./paralleltraversal
+//
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "elements/elements.h"
+#include "elements/paralleltraversal.h"
+
+using namespace vcoder;
+
+/// @brief A root with a million leaves: its children get spread across the workers, each visited once.
+static void testFlatTreeIsSpread()
+{
+    elements::Root root;
+    for(int i = 0; i < 1000000; i++)
+        root.addChild(new elements::Function("f" + std::to_string(i)));
+    
+    std::atomic<std::size_t> visited(0);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    elements::forAllDescendantsParallel(root, [&](elements::BasicElement&) {
+        visited++;
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    }, 4);
+    
+    assert(visited == 1000001);
+    assert(threads.size() > 1);
+}
+
+/// @brief An unbalanced tree, one deep chain next to a wide level, is reduced over every element.
+static void testUnbalancedReduce()
+{
+    elements::Root root;
+    elements::BasicElement* chain = &root;
+    for(int i = 0; i < 5000; i++)
+    {
+        auto next = new elements::Namespace("n");
+        chain->addChild(next);
+        chain = next;
+    }
+    for(int i = 0; i < 5000; i++)
+        root.addChild(new elements::Type("t" + std::to_string(i)));
+    
+    auto count = elements::reduceDescendantsParallel(root, std::size_t(0), [](elements::BasicElement&) { return std::size_t(1); },
+                                                     [](std::size_t a, std::size_t b) { return a + b; }, 4);
+    assert(count == 10001);
+}
+
+int main()
+{
+    testFlatTreeIsSpread();
+    testUnbalancedReduce();
+    std::puts("paralleltraversal: ok");
+}
@@ -0,0 +1,142 @@
+//
+//  prefixindex.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/prefixindex.cpp -o prefixindex && ./prefixindex
+//
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+
+#include "elements/elements.h"
+#include "elements/prefixindex.h"
+
+using namespace vcoder;
+
+static std::size_t countCompletions(const elements::PrefixIndex& index, const std::string& prefix)
+{
+    return index.complete(prefix, SIZE_MAX).size();
+}
+
+/// @brief Adding elements one by one past the buffer's limit, with fewer names than that already sorted.
+static void testFlushIntoSmallArray()
+{
+    elements::Root root;
+    elements::PrefixIndex index;
+    index.attach(root);
+    
+    for(int i = 0; i < 600; i++)
+        root.addChild(new elements::Namespace("name" + std::to_string(i)));
+    
+    assert(countCompletions(index, "name") == 600);
+    assert(countCompletions(index, "name59") == 11);
+}
+
+/// @brief Adding elements past the buffer's limit to an index attached to many names: old and new ones stay found.
+static void testFlushIntoLargeArray()
+{
+    elements::Root root;
+    for(int i = 0; i < 1000; i++)
+        root.addChild(new elements::Namespace("old" + std::to_string(i)));
+    
+    elements::PrefixIndex index;
+    index.attach(root);
+    for(int i = 0; i < 300; i++)
+        root.addChild(new elements::Function("new" + std::to_string(i)));
+    
+    assert(countCompletions(index, "old") == 1000);
+    assert(countCompletions(index, "new") == 300);
+    
+    auto all = index.complete("", SIZE_MAX);
+    for(std::size_t i = 1; i < all.size(); i++)
+        assert(all[i - 1]->name() <= all[i]->name());
+}
+
+/// @brief Adding a subtree holding more names than the buffer takes, in one change.
+static void testAddLargeSubtree()
+{
+    elements::Root root;
+    elements::PrefixIndex index;
+    index.attach(root);
+    
+    auto ns = new elements::Namespace("subtree");
+    for(int i = 0; i < 5000; i++)
+        ns->addChild(new elements::Type("type" + std::to_string(i)));
+    root.addChild(ns);
+    
+    assert(countCompletions(index, "type") == 5000);
+    assert(countCompletions(index, "sub") == 1);
+}
+
+/// @brief Names added in random order to a large index, whose buffer is past its minimum size, match a sorted set.
+static void testRandomAdditionsToLargeArray()
+{
+    elements::Root root;
+    std::set<std::string> expected;
+    for(int i = 0; i < 100000; i++)
+        expected.insert("base" + std::to_string(i));
+    for(auto& name : expected)
+        root.addChild(new elements::Namespace(name));
+    expected.insert(root.name());
+    
+    elements::PrefixIndex index;
+    index.attach(root);
+    std::mt19937 random(42);
+    for(int i = 0; i < 2000; i++)
+    {
+        auto name = "n" + std::to_string(random() % 100000);
+        if(expected.insert(name).second)
+            root.addChild(new elements::Function(name));
+        
+        if(i % 100 == 0)
+        {
+            auto prefix = "n" + std::to_string(random() % 100);
+            auto found = index.complete(prefix, SIZE_MAX);
+            auto first = expected.lower_bound(prefix);
+            for(auto elem : found)
+                assert(first != expected.end() && elem->name() == *first++);
+            assert(first == expected.end() || first->compare(0, prefix.size(), prefix) != 0);
+        }
+    }
+    
+    auto all = index.complete("", SIZE_MAX);
+    assert(all.size() == expected.size());
+    auto name = expected.begin();
+    for(auto elem : all)
+        assert(elem->name() == *name++);
+}
+
+/// @brief Completions filtered by kind keep the other kinds' namesakes out.
+static void testKindFilter()
+{
+    elements::Root root;
+    root.addChild(new elements::Namespace("shared"));
+    root.addChild(new elements::Function("shared"));
+    root.addChild(new elements::Function("sharedToo"));
+    
+    elements::PrefixIndex index;
+    index.attach(root);
+    
+    auto functions = index.complete("sha", SIZE_MAX, elements::ElementKind::Function);
+    assert(functions.size() == 2);
+    for(auto elem : functions)
+        assert(elem->kind() == elements::ElementKind::Function);
+    assert(index.complete("sha", SIZE_MAX, elements::ElementKind::Type).empty());
+    assert(countCompletions(index, "sha") == 3);
+}
+
+int main()
+{
+    testFlushIntoSmallArray();
+    testFlushIntoLargeArray();
+    testAddLargeSubtree();
+    testRandomAdditionsToLargeArray();
+    testKindFilter();
+    std::puts("prefixindex: ok");
+}
@@ -0,0 +1,78 @@
+//
+//  references.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/references.cpp -o references && ./references
+//
+
+#include <cassert>
+#include <cstdio>
+
+#include "model/document.h"
+
+using namespace vcoder;
+
+/// @brief Elements the history deletes lose their handles and edges: a reused handle starts out without any.
+static void testDeletedElementsAreForgotten()
+{
+    model::Document document;
+    document.create();
+    auto user = document.make<elements::Function>("user");
+    auto used = document.make<elements::Type>("used");
+    document.root()->addChild(user);
+    document.root()->addChild(used);
+    
+    auto from = document.handles().acquire(*user);
+    auto to = document.handles().acquire(*used);
+    document.references().addEdge(from, to);
+    
+    // Removed elements keep their handles, as undo may bring them back
+    {
+        auto edits = document.transaction();
+        document.remove(*used);
+        edits.commit();
+    }
+    assert(document.handles().element(to) == used);
+    assert(document.references().hasEdge(from, to));
+    
+    // Once the history drops the removal, the element is deleted along with its handle and edges
+    {
+        auto edits = document.transaction();
+        user->setName("renamed");
+        edits.commit();
+    }
+    document.history().setLimit(0);
+    assert(document.handles().element(to) == nullptr);
+    assert(document.references().uses(from).empty());
+    
+    auto reused = document.make<elements::Type>("reused");
+    document.root()->addChild(reused);
+    assert(document.handles().acquire(*reused) == to);
+    assert(document.references().users(to).empty());
+    document.close();
+}
+
+/// @brief Edits that cancel buffered ones don't count towards the next merge.
+static void testCancelledDeltas()
+{
+    elements::ReferenceGraph graph;
+    graph.build({ { 0, 1 } });
+    
+    graph.addEdge(2, 3);
+    graph.removeEdge(2, 3);
+    assert(graph.deltaCount() == 0);
+    
+    graph.removeEdge(0, 1);
+    graph.addEdge(0, 1);
+    assert(graph.deltaCount() == 0 && graph.hasEdge(0, 1));
+}
+
+int main()
+{
+    testDeletedElementsAreForgotten();
+    testCancelledDeltas();
+    std::puts("references: ok");
+}
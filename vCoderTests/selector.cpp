@@ -0,0 +1,56 @@
+//
+//  selector.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/selector.cpp -o selector && ./selector
+//
+
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+
+#include "elements/elements.h"
+#include "elements/selector.h"
+
+using namespace vcoder;
+
+/// @brief Selector kind steps match by kind, with or without the index, and unknown kinds are rejected.
+static void testSelectorKinds()
+{
+    elements::Root root;
+    auto outer = new elements::Namespace("outer");
+    outer->addChild(new elements::Function("inner"));
+    outer->addChild(new elements::Type("inner"));
+    root.addChild(outer);
+    
+    elements::IntervalLabeler labels;
+    labels.attach(root);
+    elements::KindIndex kinds;
+    kinds.attach(root, labels);
+    
+    elements::Selector functions("**/[Function]");
+    assert(functions.select(root).size() == 1);
+    assert(functions.select(root, &kinds).size() == 1);
+    assert(elements::Selector("outer/inner[Type]").select(root).size() == 1);
+    
+    auto threw = false;
+    try
+    {
+        elements::Selector("**/[Method]");
+    }
+    catch(const std::runtime_error&)
+    {
+        threw = true;
+    }
+    assert(threw);
+    kinds.detach();
+}
+
+int main()
+{
+    testSelectorKinds();
+    std::puts("selector: ok");
+}
@@ -0,0 +1,203 @@
+//
+//  snapshot.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/snapshot.cpp -o snapshot && ./snapshot
+//
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model/document.h"
+
+using namespace vcoder;
+
+/// @brief Describes a tree's names and shape, e.g. "_ROOT(a(f)b)".
+static std::string describe(const elements::BasicElement& elem)
+{
+    auto result = elem.name() + "(";
+    for(auto child = elem.firstChild(); child; child = child->nextSibling())
+        result += describe(*child);
+    return result + ")";
+}
+
+static std::string describe(const model::SnapshotNode& node)
+{
+    auto result = node.name() + "(";
+    for(auto& child : node.children())
+        result += describe(*child);
+    return result + ")";
+}
+
+static std::size_t countNodes(const model::SnapshotNode& node)
+{
+    std::size_t count = 1;
+    for(auto& child : node.children())
+        count += countNodes(*child);
+    return count;
+}
+
+/// @brief Snapshots keep showing the version they pinned while later edits get published, and are reclaimed once
+///        dropped.
+static void testPinnedVersions()
+{
+    model::Document document;
+    document.create();
+    auto& versions = document.versions();
+    std::mt19937 random(42);
+    
+    std::vector<model::VersionStore::Snapshot> snapshots;
+    std::vector<std::string> expected;
+    for(int step = 0; step < 200; step++)
+    {
+        std::vector<elements::BasicElement*> all;
+        for(auto& elem : elements::preOrder(*document.root()))
+            all.push_back(&elem);
+        
+        auto edits = document.transaction();
+        auto elem = all[random() % all.size()];
+        if(elem != document.root() && random() % 4 == 0)
+            document.remove(*elem);
+        else if(elem != document.root() && random() % 2)
+            elem->setName("r" + std::to_string(step));
+        else
+            elem->addChild(document.make<elements::Namespace>("n" + std::to_string(step)));
+        edits.commit();
+        
+        // Every 4th version is pinned: a thread can't hold more snapshots than the store has epoch slots
+        if(step % 4 == 0)
+        {
+            snapshots.push_back(versions.snapshot());
+            expected.push_back(describe(*document.root()));
+        }
+    }
+    
+    for(std::size_t i = 0; i < snapshots.size(); i++)
+    {
+        assert(describe(snapshots[i].root()) == expected[i]);
+        if(i > 0)
+            assert(snapshots[i].version() > snapshots[i - 1].version());
+    }
+    
+    // Once nothing pins them, the replaced versions are deleted by the next publish
+    assert(versions.pendingVersions() > 0);
+    snapshots.clear();
+    document.root()->addChild(document.make<elements::Namespace>("last"));
+    document.publish();
+    assert(versions.pendingVersions() == 0);
+    assert(describe(versions.snapshot().root()) == describe(*document.root()));
+    document.close();
+}
+
+/// @brief Publishing copies the edited paths only: the other subtrees are the same nodes in both versions.
+static void testSharedSubtrees()
+{
+    model::Document document;
+    document.create();
+    for(int i = 0; i < 10; i++)
+    {
+        auto ns = document.make<elements::Namespace>("ns" + std::to_string(i));
+        ns->addChild(document.make<elements::Function>("f"));
+        document.root()->addChild(ns);
+    }
+    
+    // Snapshots must be dropped before the document is closed
+    {
+        auto& versions = document.versions();
+        auto before = versions.snapshot();
+        {
+            auto edits = document.transaction();
+            document.root()->findChild("ns3")->findChild("f")->setName("g");
+            edits.commit();
+        }
+        auto after = versions.snapshot();
+        
+        for(std::size_t i = 0; i < 10; i++)
+        {
+            auto same = before.root().children()[i] == after.root().children()[i];
+            assert(same == (i != 3));
+        }
+        assert(before.root().findChild("ns3")->findChild("f"));
+        assert(after.root().findChild("ns3")->findChild("g"));
+    }
+    document.close();
+}
+
+/// @brief Readers on other threads only ever see committed versions: every transaction moves a function from one
+///        namespace to another, so no version has more or fewer functions than the first.
+static void testConcurrentReaders()
+{
+    model::Document document;
+    document.create();
+    std::vector<elements::BasicElement*> namespaces;
+    for(int i = 0; i < 20; i++)
+    {
+        auto ns = document.make<elements::Namespace>("ns" + std::to_string(i));
+        for(int j = 0; j < 10; j++)
+            ns->addChild(document.make<elements::Function>("f" + std::to_string(j)));
+        document.root()->addChild(ns);
+        namespaces.push_back(ns);
+    }
+    
+    auto& versions = document.versions();
+    auto total = countNodes(versions.snapshot().root());
+    
+    std::atomic<bool> stop(false);
+    std::atomic<std::size_t> reads(0);
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 3; i++)
+        readers.emplace_back([&]() {
+            while(!stop)
+            {
+                auto snapshot = versions.snapshot();
+                assert(countNodes(snapshot.root()) == total);
+                reads++;
+            }
+        });
+    
+    std::mt19937 random(7);
+    for(int step = 0; step < 2000; step++)
+    {
+        auto from = namespaces[random() % namespaces.size()];
+        auto to = namespaces[random() % namespaces.size()];
+        if(!from->firstChild())
+            continue;
+        
+        auto edits = document.transaction();
+        auto moved = from->firstChild();
+        document.remove(*moved);
+        to->addChild(moved);
+        edits.commit();
+        
+        if(step % 100 == 0)
+        {
+            document.undo();
+            document.redo();
+            std::this_thread::yield();
+        }
+    }
+    
+    while(reads == 0)
+        std::this_thread::yield();
+    stop = true;
+    for(auto& reader : readers)
+        reader.join();
+    assert(countNodes(versions.snapshot().root()) == total);
+    document.close();
+}
+
+int main()
+{
+    testPinnedVersions();
+    testSharedSubtrees();
+    testConcurrentReaders();
+    std::puts("snapshot: ok");
+}
@@ -0,0 +1,180 @@
+//
+//  treediff.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/treediff.cpp -o treediff && ./treediff
+//
+
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "elements/treediff.h"
+
+using namespace vcoder;
+
+static std::unique_ptr<elements::BasicElement> copyOf(elements::BasicElement& root)
+{
+    return std::unique_ptr<elements::BasicElement>(elements::BasicElement::deserialize(root.getSerializable()->serialize()));
+}
+
+static void deleteAll(const std::vector<elements::BasicElement*>& subtrees)
+{
+    for(auto elem : subtrees)
+        delete elem;
+}
+
+/// @brief Makes one random edit: adding, removing, renaming, moving, reordering or modifying an element.
+static void randomEdit(elements::BasicElement& root, std::mt19937& random)
+{
+    std::vector<elements::BasicElement*> all;
+    for(auto& elem : elements::preOrder(root))
+        all.push_back(&elem);
+    
+    auto elem = all[random() % all.size()];
+    auto isRoot = elem == &root;
+    switch(random() % 6)
+    {
+        case 0:
+        {
+            auto name = std::to_string(random() % 30);
+            if(random() % 2)
+                elem->addChild(new elements::Namespace("n" + name));
+            else
+                elem->addChild(new elements::Function("f" + name));
+            break;
+        }
+        case 1:
+            if(!isRoot)
+            {
+                elem->parent()->removeChild(elem);
+                delete elem;
+            }
+            break;
+        case 2:
+            if(!isRoot)
+                elem->setName("r" + std::to_string(random() % 30));
+            break;
+        case 3:
+        {
+            // Moving under an element outside the moved subtree
+            auto target = all[random() % all.size()];
+            auto inside = false;
+            for(auto scope = target; scope; scope = scope->parent())
+                inside = inside || scope == elem;
+            if(!isRoot && !inside)
+                target->insertChild(elem, target->firstChild());
+            break;
+        }
+        case 4:
+            // Reordering: the last child goes first
+            if(auto last = elem->lastChild())
+                elem->insertChild(last, elem->firstChild());
+            break;
+        default:
+        {
+            // The flags have no setters: flip them through the serializable
+            auto serializable = elem->getSpecificSerializable();
+            auto data = serializable->serialize();
+            for(auto& value : data)
+                if(value.is_boolean())
+                    value = !value.get<bool>();
+            serializable->deserializeFrom(data);
+            elem->specificChanged();
+            break;
+        }
+    }
+}
+
+/// @brief Patching a tree with its diff to an edited copy gives a tree equal to the copy, whatever the edits were.
+static void testRandomRoundTrips()
+{
+    for(unsigned round = 0; round < 300; round++)
+    {
+        // Both trees are built by the same edits: the flags don't survive a serialization round trip
+        elements::Root from, to;
+        std::mt19937 fromRandom(round), toRandom(round);
+        for(int i = 0; i < 40; i++)
+        {
+            randomEdit(from, fromRandom);
+            randomEdit(to, toRandom);
+        }
+        assert(elements::diffTrees(from, to).edits.empty());
+        
+        for(int i = toRandom() % 20; i >= 0; i--)
+            randomEdit(to, toRandom);
+        
+        auto script = elements::diffTrees(from, to);
+        deleteAll(elements::applyPatch(from, script));
+        assert(from.treeEquals(to, true));
+    }
+}
+
+/// @brief Moved and renamed elements are kept rather than deleted and recreated: the patch keeps their identity.
+static void testIdentityKept()
+{
+    elements::Root from;
+    auto a = new elements::Namespace("a");
+    auto b = new elements::Namespace("b");
+    auto f = new elements::Function("f");
+    auto g = new elements::Function("g");
+    a->addChild(f);
+    a->addChild(g);
+    from.addChild(a);
+    from.addChild(b);
+    
+    auto to = copyOf(from);
+    auto moved = to->findChild("a")->findChild("f");
+    moved->parent()->removeChild(moved);
+    to->findChild("b")->addChild(moved);
+    to->findChild("a")->findChild("g")->setName("h");
+    
+    auto script = elements::diffTrees(from, *to);
+    for(auto& edit : script.edits)
+        assert(edit.kind == elements::Edit::Kind::Move || edit.kind == elements::Edit::Kind::Rename);
+    
+    assert(elements::applyPatch(from, script).empty());
+    assert(from.treeEquals(*to, true));
+    assert(f->parent() == b);
+    assert(g->parent() == a && g->name() == "h");
+}
+
+/// @brief A patch only applies to a tree equal to the one it was computed from, and leaves any other untouched.
+static void testWrongBase()
+{
+    elements::Root from;
+    from.addChild(new elements::Namespace("a"));
+    auto to = copyOf(from);
+    to->findChild("a")->addChild(new elements::Function("f"));
+    auto script = elements::diffTrees(from, *to);
+    
+    elements::Root other;
+    other.addChild(new elements::Namespace("b"));
+    auto before = copyOf(other);
+    auto thrown = false;
+    try
+    {
+        elements::applyPatch(other, script);
+    }
+    catch(const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(other.treeEquals(*before, true));
+}
+
+int main()
+{
+    testRandomRoundTrips();
+    testIdentityKept();
+    testWrongBase();
+    std::puts("treediff: ok");
+}
@@ -0,0 +1,224 @@
+//
+//  treemerge.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/treemerge.cpp -o treemerge && ./treemerge
+//
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "elements/treemerge.h"
+
+using namespace vcoder;
+
+/// @brief Makes one random edit inside a scope: adding, removing, renaming, moving, reordering or modifying an element.
+/// @param names Numbers the names given: they're unique within a tree, as in code
+static void randomEdit(elements::BasicElement& scope, std::mt19937& random, const std::string& prefix, int& names)
+{
+    std::vector<elements::BasicElement*> all;
+    for(auto& elem : elements::preOrder(scope))
+        all.push_back(&elem);
+    
+    auto elem = all[random() % all.size()];
+    auto isScope = elem == &scope;
+    switch(random() % 6)
+    {
+        case 0:
+            if(random() % 2)
+                elem->addChild(new elements::Namespace(prefix + "n" + std::to_string(names++)));
+            else
+                elem->addChild(new elements::Function(prefix + "f" + std::to_string(names++)));
+            break;
+        case 1:
+            if(!isScope)
+            {
+                elem->parent()->removeChild(elem);
+                delete elem;
+            }
+            break;
+        case 2:
+            if(!isScope)
+                elem->setName(prefix + "r" + std::to_string(names++));
+            break;
+        case 3:
+        {
+            // Moving under an element outside the moved subtree
+            auto target = all[random() % all.size()];
+            auto inside = false;
+            for(auto parent = target; parent; parent = parent->parent())
+                inside = inside || parent == elem;
+            if(!isScope && !inside)
+                target->insertChild(elem, target->firstChild());
+            break;
+        }
+        case 4:
+            // Reordering: the last child goes first
+            if(auto last = elem->lastChild())
+                elem->insertChild(last, elem->firstChild());
+            break;
+        default:
+        {
+            // The flags have no setters: flip them through the serializable
+            auto serializable = elem->getSpecificSerializable();
+            auto data = serializable->serialize();
+            for(auto& value : data)
+                if(value.is_boolean())
+                    value = !value.get<bool>();
+            serializable->deserializeFrom(data);
+            elem->specificChanged();
+            break;
+        }
+    }
+}
+
+/// @brief Builds the same random tree for every seed: under namespaces A and B.
+static void buildBase(elements::Root& root, unsigned seed)
+{
+    auto a = new elements::Namespace("A");
+    auto b = new elements::Namespace("B");
+    root.addChild(a);
+    root.addChild(b);
+    
+    std::mt19937 random(seed);
+    int names = 0;
+    for(int i = 0; i < 30; i++)
+        randomEdit(random() % 2 ? *a : *b, random, "", names);
+}
+
+static void deleteAll(const std::vector<elements::BasicElement*>& subtrees)
+{
+    for(auto elem : subtrees)
+        delete elem;
+}
+
+/// @brief When only one side changed the base, the merge is that side.
+static void testOneSideChanged()
+{
+    for(unsigned round = 0; round < 200; round++)
+    {
+        elements::Root base, ours, theirs;
+        buildBase(base, round);
+        buildBase(ours, round);
+        buildBase(theirs, round);
+        
+        std::mt19937 random(round);
+        int names = 0;
+        for(int i = random() % 20; i >= 0; i--)
+            randomEdit(theirs, random, "t", names);
+        
+        auto result = elements::mergeTrees(base, ours, theirs);
+        assert(result.conflicts.empty());
+        assert(ours.treeEquals(theirs, true));
+        deleteAll(result.removed);
+        
+        // The other way around: theirs is the base itself
+        elements::Root changed, copy;
+        buildBase(changed, round);
+        buildBase(copy, round);
+        std::mt19937 changedRandom(round), copyRandom(round);
+        int changedNames = 0, copyNames = 0;
+        for(int i = 0; i < 10; i++)
+        {
+            randomEdit(changed, changedRandom, "o", changedNames);
+            randomEdit(copy, copyRandom, "o", copyNames);
+        }
+        result = elements::mergeTrees(base, changed, base);
+        assert(result.conflicts.empty() && result.removed.empty());
+        assert(changed.treeEquals(copy, true));
+    }
+}
+
+/// @brief Edits to different subtrees are all kept: ours made in A, theirs in B.
+static void testDisjointEdits()
+{
+    for(unsigned round = 0; round < 200; round++)
+    {
+        elements::Root base, ours, theirs, oursCopy;
+        buildBase(base, round);
+        buildBase(ours, round);
+        buildBase(theirs, round);
+        buildBase(oursCopy, round);
+        
+        std::mt19937 oursRandom(round), copyRandom(round), theirsRandom(round + 1000);
+        int oursNames = 0, copyNames = 0, theirsNames = 0;
+        for(int i = 0; i < 10; i++)
+        {
+            randomEdit(*ours.findChild("A"), oursRandom, "o", oursNames);
+            randomEdit(*oursCopy.findChild("A"), copyRandom, "o", copyNames);
+            randomEdit(*theirs.findChild("B"), theirsRandom, "t", theirsNames);
+        }
+        
+        auto result = elements::mergeTrees(base, ours, theirs);
+        assert(result.conflicts.empty());
+        assert(ours.findChild("A")->treeEquals(*oursCopy.findChild("A"), true));
+        assert(ours.findChild("B")->treeEquals(*theirs.findChild("B"), true));
+        deleteAll(result.removed);
+    }
+}
+
+static bool hasConflict(const elements::MergeResult& result, elements::MergeConflict::Kind kind)
+{
+    for(auto& conflict : result.conflicts)
+        if(conflict.kind == kind)
+            return true;
+    return false;
+}
+
+/// @brief Changes both sides made differently are reported, keeping ours.
+static void testConflicts()
+{
+    auto build = [](elements::Root& root) {
+        auto a = new elements::Namespace("A");
+        a->addChild(new elements::Function("f"));
+        root.addChild(a);
+        root.addChild(new elements::Namespace("B"));
+    };
+    elements::Root base, ours, theirs;
+    build(base);
+    build(ours);
+    build(theirs);
+    
+    // Both renamed A::f, differently
+    ours.findChild("A")->findChild("f")->setName("g");
+    theirs.findChild("A")->findChild("f")->setName("h");
+    
+    // Theirs deleted B, where ours added a child
+    auto deleted = theirs.findChild("B");
+    theirs.removeChild(deleted);
+    delete deleted;
+    ours.findChild("B")->addChild(new elements::Function("kept"));
+    
+    // Both added C, with different children
+    auto oursC = new elements::Namespace("C");
+    oursC->addChild(new elements::Function("x"));
+    ours.addChild(oursC);
+    auto theirsC = new elements::Namespace("C");
+    theirsC->addChild(new elements::Function("y"));
+    theirs.addChild(theirsC);
+    
+    auto result = elements::mergeTrees(base, ours, theirs);
+    assert(result.conflicts.size() == 3);
+    assert(hasConflict(result, elements::MergeConflict::Kind::Rename));
+    assert(hasConflict(result, elements::MergeConflict::Kind::DeleteModify));
+    assert(hasConflict(result, elements::MergeConflict::Kind::AddAdd));
+    assert(result.removed.empty());
+    
+    assert(ours.findChild("A")->findChild("g"));
+    assert(ours.findChild("B")->findChild("kept"));
+    assert(ours.findChild("C")->findChild("x") && !ours.findChild("C")->findChild("y"));
+}
+
+int main()
+{
+    testOneSideChanged();
+    testDisjointEdits();
+    testConflicts();
+    std::puts("treemerge: ok");
+}
@@ -0,0 +1,179 @@
+//
+//  undo.cpp
+//  vCoderTests
+//
+//  Copyright © 2020 osdever. All rights reserved.
+//
+//  Build and run from the repository root:
+//  c++ -std=c++17 -pthread -IvCoder vCoderTests/undo.cpp -o undo && ./undo
+//
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "model/document.h"
+
+using namespace vcoder;
+
+static std::string dump(model::Document& document)
+{
+    std::stringstream stream;
+    document.save(stream);
+    return stream.str();
+}
+
+/// @brief Flips an element's type-specific flag through its serializable: the flags have no setters.
+static void flipFlag(elements::BasicElement& elem)
+{
+    auto serializable = elem.getSpecificSerializable();
+    auto data = serializable->serialize();
+    for(auto& value : data)
+        if(value.is_boolean())
+            value = !value.get<bool>();
+    serializable->deserializeFrom(data);
+}
+
+/// @brief Makes one random edit: adding, removing, renaming, moving or modifying an element.
+/// @return Whether the tree changed: the root can't be removed, renamed or moved, and an element can't be renamed or
+///         moved to where it is
+static bool randomEdit(model::Document& document, std::mt19937& random)
+{
+    std::vector<elements::BasicElement*> all;
+    for(auto& elem : elements::preOrder(*document.root()))
+        all.push_back(&elem);
+    
+    auto elem = all[random() % all.size()];
+    auto isRoot = elem == document.root();
+    switch(random() % 5)
+    {
+        case 0:
+            if(random() % 2)
+                elem->addChild(document.make<elements::Namespace>("n" + std::to_string(random() % 20)));
+            else
+                elem->addChild(document.make<elements::Function>("f" + std::to_string(random() % 20)));
+            return true;
+        case 1:
+            if(isRoot)
+                return false;
+            document.remove(*elem);
+            return true;
+        case 2:
+        {
+            auto name = "r" + std::to_string(random() % 20);
+            if(isRoot || elem->name() == name)
+                return false;
+            elem->setName(name);
+            return true;
+        }
+        case 3:
+        {
+            // Moving under an element outside the moved subtree
+            auto target = all[random() % all.size()];
+            auto inside = false;
+            for(auto scope = target; scope; scope = scope->parent())
+                inside = inside || scope == elem;
+            if(isRoot || inside || target->firstChild() == elem)
+                return false;
+            target->insertChild(elem, target->firstChild());
+            return true;
+        }
+        default:
+            document.modify(*elem, flipFlag);
+            return true;
+    }
+}
+
+/// @brief Undoing random steps brings back every earlier state in turn, and redoing them replays every later one.
+static void testRandomUndoRedo()
+{
+    model::Document document;
+    document.create();
+    std::mt19937 random(42);
+    
+    std::vector<std::string> states { dump(document) };
+    for(int step = 0; step < 1000; step++)
+    {
+        // Empty transactions don't make undo steps: each step makes at least one edit
+        auto edits = document.transaction();
+        for(int i = random() % 3; i >= 0;)
+            if(randomEdit(document, random))
+                i--;
+        edits.commit();
+        states.push_back(dump(document));
+    }
+    
+    for(auto state = states.size() - 1; state > 0; state--)
+    {
+        assert(dump(document) == states[state]);
+        assert(document.undo());
+    }
+    assert(dump(document) == states[0]);
+    assert(!document.undo());
+    
+    for(std::size_t state = 1; state < states.size(); state++)
+    {
+        assert(document.redo());
+        assert(dump(document) == states[state]);
+    }
+    assert(!document.redo());
+    document.close();
+}
+
+/// @brief A transaction destroyed uncommitted reverts its edits, nested ones included, and leaves no undo step.
+static void testRollback()
+{
+    model::Document document;
+    document.create();
+    auto ns = document.make<elements::Namespace>("ns");
+    document.root()->addChild(ns);
+    auto before = dump(document);
+    
+    std::mt19937 random(7);
+    {
+        auto outer = document.transaction();
+        for(int i = 0; i < 50; i++)
+        {
+            auto inner = document.transaction();
+            randomEdit(document, random);
+            inner.commit();
+        }
+    }
+    assert(dump(document) == before);
+    
+    // The last step is still the addition of ns
+    assert(document.undo());
+    assert(document.root()->childCount() == 0);
+    assert(!document.undo());
+    document.close();
+}
+
+/// @brief A new edit after undoing drops the steps that could have been redone.
+static void testEditDropsRedo()
+{
+    model::Document document;
+    document.create();
+    document.root()->addChild(document.make<elements::Namespace>("a"));
+    document.root()->addChild(document.make<elements::Namespace>("b"));
+    
+    assert(document.undo());
+    assert(document.history().canRedo());
+    document.root()->addChild(document.make<elements::Namespace>("c"));
+    assert(!document.history().canRedo());
+    assert(!document.redo());
+    
+    assert(document.undo());
+    assert(document.root()->childCount() == 1 && document.root()->firstChild()->name() == "a");
+    document.close();
+}
+
+int main()
+{
+    testRandomUndoRedo();
+    testRollback();
+    testEditDropsRedo();
+    std::puts("undo: ok");
+}